@@ -1,32 +1,215 @@
 #ifndef AI_H
 #define AI_H
 
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+
 #include "game.h"
+#include "bitboard.h"
+#include "rules.h"
 
 // if a node has never been visited, we want to ensure it gets picked at least once
 #define INITIAL_UCB 99999999.
 
 #define MAX_ITERATIONS 10
 
+// exploration constant in the UCB formula
+#define UCB_EXPLORATION 1.41
+
+/*
+  Ultimate has up to 81 moves per turn and games last much longer, so it
+  gets a bigger budget and a smaller exploration constant to keep the
+  visits from being spread too thin across the children
+*/
+#define ULTIMATE_ITERATIONS 3000
+#define ULTIMATE_EXPLORATION 0.8
+
+// iterations run per call to ponder, small enough to keep input responsive
+#define PONDER_BATCH 50
+// stop pondering once the tree has this many iterations for the current root
+#define PONDER_MAX_ITERATIONS 2000
+
+// most visits a node's prior from the statistics cache may be worth, so
+// the new search can still change its mind
+#define CACHE_MAX_PRIOR 100
+
+// memory a search tree may use for its nodes and the lists used to
+// recycle them, 0 for no limit
+#define DEFAULT_TREE_MEMORY ((size_t)256 << 20)
+// nodes are allocated this many at a time
+#define NODE_BLOCK_SIZE 1024
+// once a tree is full, recycling frees nodes until it's down to this fraction
+#define RECYCLE_TARGET 0.75
+
+/*
+  Early stopping: every STOP_CHECK_INTERVAL iterations the search checks
+  whether the rest of its budget could still change the chosen move. Once
+  the root has STOP_MIN_VISITS visits it also stops if the best move's
+  score is confidently above every other move's, using Hoeffding
+  bounds that each hold with probability 1 - STOP_DELTA
+*/
+#define STOP_CHECK_INTERVAL 16
+#define STOP_MIN_VISITS 200
+#define STOP_DELTA 0.01
+
+/*
+  How the move is picked once the search is over. The robust child is the
+  most visited one. Max-robust wants the most visited child to also have
+  the best score, and searches on in batches of MAX_ROBUST_BATCH (up to
+  1/MAX_ROBUST_EXTRA of the budget again) until it does
+*/
+typedef enum FinalSelection {
+  FS_ROBUST,
+  FS_MAX_ROBUST
+} FinalSelection;
+
+/*
+  RAVE: every node also keeps all-moves-as-first statistics, counting each
+  playout through its parent in which its move was played later on by the
+  same side. They're blended into the score with a weight that fades as
+  the node's own visits grow, reaching half at RAVE_EQUIVALENCE / 3
+  visits. 0 turns RAVE off.
+
+  It only pays off on boards with room to spare: from 7x7 up it wins
+  most games against plain UCT at the same iterations, on 6x6 and in
+  ultimate it loses or breaks even, so smaller boards don't use it
+*/
+#define RAVE_EQUIVALENCE 300.
+#define RAVE_MIN_SQUARES 49
+
+#define MAX_ROBUST_BATCH 64
+#define MAX_ROBUST_EXTRA 4
+
+/*
+  Everything that changes how a tree plays. search_position uses the
+  defaults for the board (get_search_params), search_position_with lets
+  the caller pick, e.g. to play different settings against each other
+  (see main_tune.c)
+*/
+typedef struct SearchParams {
+  double exploration;       // exploration constant in the UCB formula
+  double raveEquivalence;   // 0 turns RAVE off
+  bool grabWins;            // playouts take a win when there is one
+  bool blockLosses;         // playouts block the opponent's win
+  bool earlyStopping;
+  FinalSelection finalSelection;
+  int solveEmpty;           // solve exactly with this many empty squares or fewer, 0 never
+} SearchParams;
+
 typedef struct Node {
   void *parent;
   int childCount;
-  void **children;
-  Board *board;
+  void *firstChild;
+  void *nextSibling;    // also links the pool's free list
+  Position pos;
   Piece nextTurn;
+  Piece winner;         // set if the move into this node completed a line
   int movePos;    // -1 is reserved for the root note
   int visitCount;
   int winCount;
-  double ucb;
+  int drawCount;
+  int amafVisits;
+  int amafWins;
+  int amafDraws;
+  uint64_t cacheKey;    // canonical key, 0 if the statistics cache is off
+  int priorVisits;      // seeded from the cache, not flushed back to it
+  int priorWins;
+  int priorDraws;
 } Node;
 
+/*
+  Every node of a tree comes out of the tree's pool: blocks of
+  NODE_BLOCK_SIZE nodes that are only freed along with the tree, plus a
+  free list of nodes handed back by destroyed subtrees
+*/
+typedef struct NodePool {
+  void *blocks;         // most recently allocated NodeBlock first
+  int blockUsed;        // nodes handed out from the newest block
+  Node *freeList;
+  size_t liveNodes;
+  size_t maxNodes;      // 0 for no limit
+  size_t bytes;         // allocated for blocks and scratch, never goes down
+  Node **scratch;       // work lists for recycling, kept between recycles
+  size_t scratchSize;   // nodes each of the two lists has room for
+} NodePool;
+
 typedef struct Tree {
   Node *root;
-  int iterCount;
-  Piece player;     // the player we're evaluating
+  NodePool pool;
+  long recycledNodes;   // freed to make room since the tree was created
+  Rules rules;
+  SearchParams params;
+  int iterCount;    // iterations run since the root was last set
+  Piece player;     // the player to move at the root
+  bool solveFailed; // the solver gave up on the root, search it instead
 } Tree;
 
+/*
+  Formats export_search_tree can write. Both are streamed out node by
+  node during one walk of the tree:
+
+    TF_DOT    a Graphviz digraph, one node and one edge per tree node
+    TF_JSON   JSON lines, one object per node with its parent's id, in
+              depth-first order so a parent always comes first
+*/
+typedef enum TreeFormat {
+  TF_DOT,
+  TF_JSON
+} TreeFormat;
+
+typedef struct SearchStats {
+  int move;         // chosen square, -1 if there was nothing to search
+  int iterations;   // iterations run by this search
+  int savedIterations;  // left unused because the move was already settled
+  int rootVisits;   // includes visits carried over from earlier searches
+  int moveVisits;
+  double value;     // expected score of the chosen move for the side to move, a draw counts half
+  double win;       // outcome rates of the chosen move, all 0 if it wasn't searched
+  double draw;
+  double loss;
+  bool solved;      // the move came from the exact solver, the rates are exact
+  size_t treeBytes; // memory the tree has allocated for nodes and recycling so far
+  long recycledNodes;
+} SearchStats;
+
+/*
+  Search handle, for callers that run the search from their own loop:
+  make one from a position, step it a slice at a time, ask for the best
+  move whenever, and apply moves to re-root it. A handle has its own tree
+  and takes no locks, so use each one from one thread at a time
+*/
+typedef struct Search {
+  Tree *tree;
+  bool solveTried;        // the solver has had its go at the current root
+  bool solved;
+  SearchStats solution;    // what the solver found, if it did
+} Search;
+
 int next_move(Game *g);
 int get_next_move(Game *g);
+int get_next_move_within(Game *g, int ms);
+int search_position(Game *g, int iterations, SearchStats *stats);
+int search_position_with(Game *g, const SearchParams *params, int iterations, int cpuMs, SearchStats *stats);
+void get_search_params(Game *g, SearchParams *params);
+
+bool ponder(Game *g);
+void advance_search_tree(Game *g, int pos);
+void destroy_search_tree(Game *g);
+
+long export_search_tree(Tree *t, FILE *out, TreeFormat format, int maxDepth, int minVisits);
+
+void set_tree_memory_budget(size_t bytes);
+void set_early_stopping(bool enabled);
+void set_final_selection(FinalSelection selection);
+void set_rave_equivalence(double equivalence);
+
+Search *new_search(Game *g, const SearchParams *params);
+int step_search(Search *s, int iterations);
+bool is_search_settled(Search *s, int remaining);
+int get_search_move(Search *s, SearchStats *stats);
+bool apply_search_move(Search *s, int pos);
+void destroy_search(Search *s);
 
 #endif /* AI_H */
\ No newline at end of file
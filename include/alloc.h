@@ -0,0 +1,21 @@
+#ifndef ALLOC_H
+#define ALLOC_H
+
+#include <stddef.h>
+
+/*
+  Every heap allocation in libttt goes through ttt_malloc and ttt_free,
+  which call malloc and free unless set_alloc_hooks swaps in something
+  else, e.g. an allocator that counts calls to check a loop allocates
+  nothing once it's warmed up. The hooks are process-wide; set them
+  before any game or search exists.
+*/
+
+typedef void *(*AllocHook)(size_t size);
+typedef void (*FreeHook)(void *ptr);
+
+void set_alloc_hooks(AllocHook alloc, FreeHook release);
+void *ttt_malloc(size_t size);
+void ttt_free(void *ptr);
+
+#endif /* ALLOC_H */
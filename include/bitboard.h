@@ -0,0 +1,55 @@
+#ifndef BITBOARD_H
+#define BITBOARD_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "game.h"
+
+/*
+  Squares are laid out row by row with one spare bit after every row
+  (stride = cols + 1). The spare column is always empty, so shifting a
+  bitboard sideways or diagonally can never carry a piece from the end
+  of one row into the start of the next.
+*/
+
+#define BB_WORDS (((MAX_BOARD_DIM * (MAX_BOARD_DIM + 1)) + 63) / 64)
+
+typedef struct Bitboard {
+  uint64_t w[BB_WORDS];
+} Bitboard;
+
+typedef struct Geometry {
+  int rows;
+  int cols;
+  int k;            // pieces in a row needed to win
+  int stride;       // bits per row, including the spare column
+  int numSquares;
+  int shifts[4];    // bit distance between neighbours on each line direction
+  Bitboard squares; // every bit that is a real square
+} Geometry;
+
+void init_geometry(Geometry *geom, int rows, int cols, int k);
+
+int geom_bit(Geometry *geom, int pos);
+int geom_pos(Geometry *geom, int bit);
+
+void bb_clear(Bitboard *b);
+bool bb_is_empty(Bitboard *b);
+bool bb_equal(Bitboard *a, Bitboard *b);
+bool bb_test(Bitboard *b, int bit);
+void bb_set(Bitboard *b, int bit);
+void bb_unset(Bitboard *b, int bit);
+int bb_count(Bitboard *b);
+int bb_nth_bit(Bitboard *b, int n);
+int bb_first_bit(Bitboard *b);
+
+void bb_and(Bitboard *tgt, Bitboard *a, Bitboard *b);
+void bb_or(Bitboard *tgt, Bitboard *a, Bitboard *b);
+void bb_andnot(Bitboard *tgt, Bitboard *a, Bitboard *b);
+void bb_shift(Bitboard *tgt, Bitboard *src, int n);
+
+bool bb_has_line(Geometry *geom, Bitboard *b);
+void bb_winning_squares(Geometry *geom, Bitboard *b, Bitboard *empty, Bitboard *tgt);
+
+#endif /* BITBOARD_H */
@@ -0,0 +1,47 @@
+#ifndef BOOK_H
+#define BOOK_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "game.h"
+#include "rules.h"
+
+/*
+  Opening book: the engine's move for the early positions of one board
+  type, worked out ahead of time by long searches (see main_book.c).
+
+  The file is a BookHeader followed by BookEntry records sorted by key,
+  in native byte order so it can be searched in place once mapped. Keys
+  are canonical position keys (get_canonical_key) and moves are stored
+  for the canonical form, so one entry covers every mirror image of a
+  position.
+*/
+
+#define BOOK_MAGIC "TTTB"
+#define BOOK_VERSION 1
+
+typedef struct BookHeader {
+  char magic[4];
+  uint8_t version;
+  uint8_t variant;
+  uint8_t rows;
+  uint8_t cols;
+  uint8_t k;
+  uint8_t reserved[3];
+  uint32_t count;
+} BookHeader;
+
+typedef struct BookEntry {
+  uint64_t key;
+  uint16_t move;      // square, in the canonical form's frame
+  uint16_t reserved;
+  uint32_t visits;    // how much searching backs the move
+} BookEntry;
+
+bool load_opening_book(const char *path, GameVariant variant, int rows, int cols, int k);
+void unload_opening_book();
+int probe_opening_book(Game *g);
+void get_opening_book_stats(long *hits, long *misses);
+
+#endif /* BOOK_H */
@@ -0,0 +1,53 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+/*
+  Search statistics kept on disk between runs: visits, wins and draws
+  per position, keyed by canonical position key (get_canonical_key) so
+  mirror images share an entry. Wins are counted for the player who
+  made the last move, like Node.winCount.
+
+  The file is a CacheHeader followed by a fixed size open-addressing
+  table of CacheSlots, mapped shared and updated in place with atomics,
+  so several threads or processes can use one cache at the same time.
+  A slot whose key is 0 is free.
+*/
+
+#define CACHE_MAGIC "TTTC"
+#define CACHE_VERSION 2
+#define DEFAULT_CACHE_SLOT_BITS 20    // a million slots, 24MB (sparse until used)
+
+// how far along the table a key may land before it's dropped
+#define CACHE_MAX_PROBES 16
+// a slot stops taking stats at this many visits. Adds that race past it
+// still leave the 32-bit counters far from wrapping
+#define CACHE_MAX_VISITS (UINT32_C(1) << 30)
+
+typedef struct CacheHeader {
+  char magic[4];
+  uint8_t version;
+  uint8_t reserved[3];
+  uint32_t slotBits;
+  uint32_t reserved2;
+} CacheHeader;
+
+typedef struct CacheSlot {
+  _Atomic uint64_t key;
+  _Atomic uint32_t visits;
+  _Atomic uint32_t wins;
+  _Atomic uint32_t draws;
+} CacheSlot;
+
+bool open_stats_cache(const char *path, int slotBits);
+void close_stats_cache();
+bool is_stats_cache_open();
+
+bool lookup_cached_stats(uint64_t key, int *visits, int *wins, int *draws);
+void add_cached_stats(uint64_t key, int visits, int wins, int draws);
+void get_stats_cache_counts(uint64_t *hits, uint64_t *misses, uint64_t *dropped);
+
+#endif /* CACHE_H */
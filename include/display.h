@@ -2,24 +2,105 @@
 #define DISPLAY_H
 
 #include "game.h"
+#include "latency.h"
 
 #define BOARD_ORIGIN_ROW 3
 #define BOARD_ORIGIN_COL 6
 #define BOARD_ROW_GAP 1
 #define BOARD_COL_GAP 3
 
-#define MENU_ORIGIN_ROW 9
+// screen size of a board's grid
+#define BOARD_WIDTH(cols) (((cols) * (BOARD_COL_GAP + 1)) - 1)
+#define BOARD_HEIGHT(rows) (((rows) * (BOARD_ROW_GAP + 1)) - 1)
+
+#define MENU_BOARD_GAP 2
 #define MENU_ORIGIN_COL 5
 #define MENU_PADDING 2
 #define MENU_ROW_GAP 1
 
+// columns between the ultimate grid and the sub-board status panel
+#define ULTIMATE_STATUS_GAP 4
+
 #define CURSOR_SQUARE "\u25A0"
 
+typedef enum UserInput {
+  UI_UP,
+  UI_DOWN,
+  UI_LEFT,
+  UI_RIGHT,
+  UI_ENTER,
+  UI_Q,
+  UI_NONE
+} UserInput;
+
+typedef enum UserAction {
+  UA_CURSOR_UP,
+  UA_CURSOR_DOWN,
+  UA_CURSOR_LEFT,
+  UA_CURSOR_RIGHT,
+  UA_PLACE_PIECE,
+  UA_NEW_GAME,
+  UA_QUIT,
+  UA_NONE
+} UserAction;
+
+typedef enum CursorDirection {
+  CUR_UP,
+  CUR_DOWN,
+  CUR_LEFT,
+  CUR_RIGHT
+} CursorDirection;
+
+typedef struct Location {
+  int row;
+  int col;
+} Location;
+
+typedef enum CursorCtx {
+  CURCTX_BOARD,
+  CURCTX_MENU
+} CursorCtx;
+
+/*
+  The cursor points at a square or a menu item rather than a spot on the
+  screen; where that is on the screen is worked out when it's drawn.
+*/
+typedef struct Cursor {
+  CursorCtx ctx;
+  int pos;          // square, or menu item
+} Cursor;
+
+typedef enum MenuAction {
+  MENU_NEW_GAME,
+  MENU_QUIT
+} MenuAction;
+
+#define MENU_ITEMS 2
+
+/*
+  A board drawn somewhere on the screen, remembering what it last drew
+  so repeated paints only touch squares that changed.
+*/
+typedef struct BoardView {
+  int row;                  // top-left corner of the grid
+  int col;
+  int block;                // heavier grid lines every block squares, 0 for none
+  bool gridDrawn;
+  int cells[MAX_SQUARES];   // last thing drawn in each square, -1 for nothing
+} BoardView;
+
+/* the main game loop */
+void play(Game *g, int recordFd, ReplyLatency *latency);
+
+MenuAction get_menu_action(int item);
+void get_menu_location(Board *b, int item, Location *l);
+
 void init_display();
-void refresh_display(Game *g);
+void refresh_display(Game *g, Cursor *c, ReplyLatency *latency);
+void invalidate_display();
 void kill_display();
 
-// non-ncurses display functions
-void print_board(Board *b, const char *msg);
+void init_board_view(BoardView *v, int row, int col, int block);
+void paint_board_view(BoardView *v, Board *b, Cursor *c);
 
 #endif /* DISPLAY_H */
\ No newline at end of file
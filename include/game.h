@@ -1,6 +1,8 @@
 #ifndef GAME_H
 #define GAME_H
 
+#include <stdbool.h>
+
 typedef enum GameState {
   GS_INIT,
   GS_PLAYER_TURN,
@@ -11,49 +13,6 @@ typedef enum GameState {
   GS_QUIT
 } GameState;
 
-typedef enum UserInput {
-  UI_UP,
-  UI_DOWN,
-  UI_LEFT,
-  UI_RIGHT,
-  UI_ENTER,
-  UI_Q,
-  UI_NONE
-} UserInput;
-
-typedef enum UserAction {
-  UA_CURSOR_UP,
-  UA_CURSOR_DOWN,
-  UA_CURSOR_LEFT,
-  UA_CURSOR_RIGHT,
-  UA_PLACE_PIECE,
-  UA_NEW_GAME,
-  UA_QUIT,
-  UA_NONE
-} UserAction;
-
-typedef enum CursorDirection {
-  CUR_UP,
-  CUR_DOWN,
-  CUR_LEFT,
-  CUR_RIGHT
-} CursorDirection;
-
-typedef struct Location {
-  int row;
-  int col;
-} Location;
-
-typedef enum CursorCtx {
-  CURCTX_BOARD,
-  CURCTX_MENU
-} CursorCtx;
-
-typedef struct Cursor {
-  CursorCtx ctx;
-  Location *loc;
-} Cursor;
-
 typedef enum BoardPlacementResult {
   BPR_OK,
   BPR_OCCUPIED,
@@ -72,88 +31,117 @@ typedef enum SquareColor {
   SQ_NONE
 } SquareColor;
 
-typedef enum Line {
-  TOP_ROW,
-  MIDDLE_ROW,
-  BOTTOM_ROW,
-  LEFT_COL,
-  CENTER_COL,
-  RIGHT_COL,
-  BACKSLASH,
-  FORWARD_SLASH,
-  NO_WINNER
-} Line;
+// largest supported board is 15x15
+#define MAX_BOARD_DIM 15
+#define MAX_SQUARES (MAX_BOARD_DIM * MAX_BOARD_DIM)
+
+typedef enum LineDirection {
+  LD_ROW,             // left to right
+  LD_COL,             // top to bottom
+  LD_BACKSLASH,       // down and to the right
+  LD_FORWARD_SLASH    // down and to the left
+} LineDirection;
+
+/*
+  A winning line is identified by the board position of its first square
+  and its direction, encoded as (pos * 4 + direction). NO_WINNER means
+  there is no line.
+*/
+typedef int Line;
+
+#define NO_WINNER -1
+#define LINE_START(l) ((l) / 4)
+#define LINE_DIRECTION(l) ((LineDirection)((l) % 4))
 
 typedef struct Square {
-  Location *loc;
   Piece piece;
   SquareColor color;
 } Square;
 
 typedef struct Board {
-  Square *squares[9];
+  int rows;
+  int cols;
+  int k;            // pieces in a row needed to win
+  int numSquares;
+  Square squares[MAX_SQUARES];
 } Board;
 
-typedef enum MenuAction {
-  MENU_NEW_GAME,
-  MENU_QUIT
-} MenuAction;
-
-typedef struct MenuItem {
-  MenuAction menuAction;
-  Location *loc;
-} MenuItem;
-
-typedef struct Menu {
-  MenuItem *items[2];
-} Menu;
-
+typedef enum GameVariant {
+  GV_STANDARD,
+  GV_ULTIMATE
+} GameVariant;
+
+// ultimate is played on a 3x3 grid of 3x3 sub-boards
+#define ULTIMATE_DIM 3
+#define ULTIMATE_SIZE (ULTIMATE_DIM * ULTIMATE_DIM)
+
+/*
+  Ultimate rules layered over the game's 9x9 board. Each sub-board and the
+  meta-board are regular 3x3 Boards, so get_winning_line decides them.
+*/
+typedef struct Ultimate {
+  Board subBoards[ULTIMATE_SIZE];
+  Board meta;       // each square holds the winner of the matching sub-board
+  int target;       // sub-board the next move has to go in, -1 for any open one
+} Ultimate;
+
+/*
+  A game is one flat value: the board lives inside it rather than behind
+  a pointer, so setting up a standard game or playing on any game never
+  allocates. The ultimate sub-boards are ten more Boards, so they're
+  allocated once when an ultimate game is set up rather than carried by
+  every game. The search tree is kept by ai.c between moves.
+*/
 typedef struct Game {
   GameState state;
-  Menu *menu;
-  Board *board;
-  Cursor *cursor;
+  GameVariant variant;
+  Board board;
+  Ultimate *ultimate; // GV_ULTIMATE only, NULL otherwise
+  void *tree;       // search tree kept between moves, owned by ai.c
 } Game;
 
-Location *new_location(int row, int col);
-void destroy_location(Location *l);
-
-Game *new_game();
+void init_game(Game *g, int rows, int cols, int k);
+void init_ultimate_game(Game *g);
+Game *new_game(int rows, int cols, int k);
+Game *new_ultimate_game();
+void release_game(Game *g);
 void destroy_game(Game *g);
+void reset_game(Game *g);
+BoardPlacementResult place_game_piece(Game *g, int pos, Piece p);
 
-Board *new_board();
-void destroy_board(Board *b);
+bool is_valid_board_size(int rows, int cols, int k);
+void init_board(Board *b, int rows, int cols, int k);
 void reset_square(Square *s);
 void reset_board(Board *b);
 
-Menu *new_menu();
-void destroy_menu(Menu *m);
-int get_menu_pos_from_cursor(Menu *m, Cursor *c);
-
 BoardPlacementResult place_piece(Board *b, int pos, Piece p);
+bool parse_board(Board *b, const char *s);
 
-int get_board_pos_from_cursor(Board *b, Cursor *c);
 int num_empty_squares(Board *b);
 char get_piece_char_from_square(Square *s);
 char get_piece_char(Piece p);
+void print_board(Board *b, const char *msg);
 
-/* the main game loop */
-void play(Game *g);
-void play_noui(Game *g);
+void update_game_state(Game *g);
 
 Piece get_next_turn(Board *b);
 Line get_winning_line(Board *b);
 char *get_line_text(Line l);
 Piece get_winning_piece(Board *b, Line wl);
+int get_line_step(Board *b, Line l);
 
 // set line colors
-void set_top_row_color(Board *b, SquareColor c);
-void set_middle_row_color(Board *b, SquareColor c);
-void set_bottom_row_color(Board *b, SquareColor c);
-void set_left_col_color(Board *b, SquareColor c);
-void set_center_col_color(Board *b, SquareColor c);
-void set_right_col_color(Board *b, SquareColor c);
-void set_backslash_color(Board *b, SquareColor c);
-void set_forwardslash_color(Board *b, SquareColor c);
+void set_line_color(Board *b, Line l, SquareColor c);
+
+// ultimate variant
+void init_ultimate(Ultimate *u);
+void reset_ultimate(Ultimate *u);
+int get_sub_board(int pos);
+int get_sub_square(int pos);
+int get_ultimate_pos(int sub, int square);
+bool is_sub_board_closed(Ultimate *u, int sub);
+bool is_ultimate_move_legal(Ultimate *u, Board *b, int pos);
+bool has_ultimate_moves(Ultimate *u, Board *b);
+BoardPlacementResult place_ultimate_piece(Ultimate *u, Board *b, int pos, Piece p);
 
 #endif /* GAME_H */
\ No newline at end of file
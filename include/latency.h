@@ -0,0 +1,75 @@
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+
+/*
+  Latency histogram with fixed log-linear buckets, in the style of
+  HdrHistogram: values under LATENCY_SUB_BUCKETS microseconds get a
+  bucket each, above that every power of two is split into
+  LATENCY_SUB_BUCKETS buckets, so a percentile is never more than about
+  6% above the true value. Recording is a shift and an increment, and
+  the histogram is a plain value with nothing to allocate or free.
+*/
+
+#define LATENCY_SUB_BITS 4
+#define LATENCY_SUB_BUCKETS (1 << LATENCY_SUB_BITS)
+// values are clamped to this, about 19 hours
+#define LATENCY_MAX_US ((UINT64_C(1) << 36) - 1)
+#define LATENCY_BUCKETS ((36 - LATENCY_SUB_BITS + 1) * LATENCY_SUB_BUCKETS)
+
+typedef struct LatencyHistogram {
+  uint32_t counts[LATENCY_BUCKETS];
+  uint64_t count;
+  uint64_t min;         // microseconds, exact
+  uint64_t max;
+  uint64_t total;
+} LatencyHistogram;
+
+/*
+  Reply times against a target. Every reply is recorded, and when there
+  is a target the time the next search may take is adjusted after each
+  one: down in proportion to how far a slow reply overshot, back up by
+  part of the slack a fast reply left.
+*/
+typedef struct ReplyLatency {
+  LatencyHistogram replies;
+  int targetMs;           // 0 for no target
+  int budgetMs;           // wall time the next search may take, 0 for no limit
+  uint64_t overTarget;    // replies slower than the target
+} ReplyLatency;
+
+// after a slow reply the budget drops to this share of what would have
+// met the target
+#define LATENCY_BACKOFF 0.9
+// after a fast reply the budget takes back this share of the slack
+#define LATENCY_RECOVERY 0.25
+
+/*
+  A time to stop at on one clock, the calling thread's CPU time or the
+  wall clock (CLOCK_MONOTONIC). A deadline with no time never passes.
+*/
+typedef struct Deadline {
+  clockid_t clock;
+  double ms;              // 0 for no deadline
+} Deadline;
+
+uint64_t get_clock_us();
+
+void init_latency_histogram(LatencyHistogram *h);
+void record_latency(LatencyHistogram *h, uint64_t us);
+uint64_t get_latency_percentile(const LatencyHistogram *h, double percentile);
+void print_latency_histogram(const LatencyHistogram *h, FILE *out);
+
+void init_reply_latency(ReplyLatency *l, int targetMs);
+void record_reply(ReplyLatency *l, uint64_t us);
+void print_reply_latency(const ReplyLatency *l, FILE *out);
+
+void set_deadline(Deadline *d, clockid_t clock, int ms);
+bool has_deadline(const Deadline *d);
+bool is_past_deadline(const Deadline *d);
+
+#endif /* LATENCY_H */
@@ -0,0 +1,97 @@
+#ifndef RECORD_H
+#define RECORD_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "game.h"
+
+/*
+  Binary game records. A record file is an 8 byte header followed by
+  records appended back to back, all integers little-endian:
+
+    header  "TTTR" magic, uint8 version, 3 bytes reserved
+
+    record  uint16 size       bytes that follow this field
+            uint8  board      rows - 1 in the high 4 bits, cols - 1 in the low 4
+            uint8  game       k - 1 in the high 4 bits, variant in bit 2,
+                              RecordResult in bits 0-1
+            uint8  players    RecordEngine that played the non-human side(s)
+                              in bits 2-3, RF_* bits in bits 0-1
+            uint32 startTime  unix seconds
+            varint durationMs
+            varint engineMs   time spent thinking by the engine
+            uint8  moves[]    square of every move, X first
+
+  A varint is 7 bits per byte, low bits first, with the top bit set on
+  every byte but the last. One log takes games of any shape, so the shape
+  is in every record, packed into two bytes. A 3x3 game that took under
+  16 seconds takes at most 22 bytes. The size prefix lets a reader hop
+  from record to record without decoding them.
+*/
+
+#define RECORD_MAGIC "TTTR"
+#define RECORD_VERSION 2
+#define RECORD_FILE_HEADER_SIZE 8
+#define RECORD_HEADER_SIZE 9        // the fixed part of a record, size field included
+#define RECORD_MAX_HEADER_SIZE 19   // with both varints at their longest
+
+// where ttt logs games if TTT_RECORDS isn't set, relative to $HOME
+#define DEFAULT_RECORD_FILE ".ttt_records"
+
+typedef enum RecordResult {
+  RR_X,
+  RR_O,
+  RR_TIE,
+  RR_UNFINISHED
+} RecordResult;
+
+typedef enum RecordEngine {
+  RE_NONE,
+  RE_MCTS,
+  RE_FIRST
+} RecordEngine;
+
+#define RF_HUMAN_X 0x01
+#define RF_HUMAN_O 0x02
+
+typedef struct GameRecord {
+  GameVariant variant;
+  int rows;
+  int cols;
+  int k;
+  RecordResult result;
+  RecordEngine engine;
+  int flags;
+  uint32_t startTime;
+  uint32_t durationMs;
+  uint32_t engineMs;
+  int numMoves;
+  uint8_t moves[MAX_SQUARES];
+
+  uint64_t startedAtMs;   // monotonic clock, not written out
+} GameRecord;
+
+typedef struct RecordFile {
+  int fd;
+  const uint8_t *data;
+  size_t size;
+} RecordFile;
+
+uint64_t get_clock_ms();
+
+void start_game_record(GameRecord *r, Game *g, RecordEngine engine, int flags);
+void add_record_move(GameRecord *r, int pos);
+void finish_game_record(GameRecord *r, GameState state);
+
+const char *get_record_path();
+int open_record_log(const char *path);
+bool write_game_record(int fd, GameRecord *r);
+
+RecordFile *open_record_file(const char *path);
+void close_record_file(RecordFile *f);
+size_t next_record_offset(RecordFile *f, size_t offset);
+bool read_game_record(RecordFile *f, size_t offset, GameRecord *r);
+
+#endif /* RECORD_H */
@@ -0,0 +1,54 @@
+#ifndef RULES_H
+#define RULES_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "game.h"
+#include "bitboard.h"
+
+/*
+  The engine's view of a game: bitboards plus the little bit of extra
+  state ultimate needs. Everything here is a plain value so positions can
+  be copied freely during playouts.
+*/
+typedef struct Position {
+  Bitboard pieces[2];   // indexed by Piece
+  uint16_t subWon[2];   // ultimate: bit i is set if that side won sub-board i
+  uint16_t subClosed;   // ultimate: sub-boards that are won or full
+  int target;           // ultimate: sub-board the next move must go in, -1 for any
+} Position;
+
+// square boards have 8 symmetries (rotations and reflections), others 4
+#define MAX_SYMMETRIES 8
+
+typedef struct Rules {
+  GameVariant variant;
+  Geometry geom;
+  Bitboard subSquares[ULTIMATE_SIZE];     // ultimate: squares of each sub-board
+  Bitboard subLines[ULTIMATE_SIZE][8];    // ultimate: the 8 lines of each sub-board
+
+  int numSymmetries;
+  uint8_t symBits[MAX_SYMMETRIES][BB_WORDS * 64];   // where each bit goes under each symmetry
+  int8_t symSubs[MAX_SYMMETRIES][ULTIMATE_SIZE];    // ultimate: where each sub-board goes
+} Rules;
+
+void init_rules(Rules *r, GameVariant variant, int rows, int cols, int k);
+void game_to_position(Rules *r, Game *g, Position *p);
+bool is_same_position(Position *a, Position *b);
+
+void get_legal_moves(Rules *r, Position *p, Bitboard *moves);
+void get_winning_moves(Rules *r, Position *p, Piece piece, Bitboard *legal, Bitboard *tgt);
+Piece play_move(Rules *r, Position *p, int bit, Piece piece);
+Piece get_position_winner(Rules *r, Position *p);
+
+// symmetry.c
+void init_symmetries(Rules *r);
+int inverse_symmetry(int sym);
+int transform_bit(Rules *r, int sym, int bit);
+void transform_position(Rules *r, int sym, Position *src, Position *tgt);
+int get_stabilizer(Rules *r, Position *p, int *syms);
+void get_unique_moves(Rules *r, Position *p, Bitboard *moves);
+uint64_t get_canonical_key(Rules *r, Position *p, int *sym);
+
+#endif /* RULES_H */
@@ -0,0 +1,40 @@
+#ifndef SOLVER_H
+#define SOLVER_H
+
+#include <stdbool.h>
+
+#include "game.h"
+#include "rules.h"
+#include "latency.h"
+
+/*
+  Exact endgame solver: a negamax search with alpha-beta pruning that
+  plays every line out to the end. Scores are from the side to move's
+  point of view, and a win scores SOLVER_WIN less the plies it takes, so
+  the solver goes for the quickest win and the slowest loss.
+
+  It's only worth running on positions with few moves left, and gives up
+  once it has looked at its node budget, or its deadline has passed, so
+  the caller can search instead.
+*/
+
+#define SOLVER_WIN 1000
+
+// search_position solves positions with this many open squares or fewer,
+// on boards with more squares than this
+#define SOLVER_MAX_EMPTY 10
+// most positions a solve may look at before it gives up
+#define SOLVER_MAX_NODES 100000
+// positions between looks at the clock
+#define SOLVER_CLOCK_INTERVAL 1024
+
+typedef struct SolverResult {
+  int move;         // best square, -1 if the game is already over
+  int value;        // 1 if the side to move wins, 0 for a draw, -1 if it loses
+  int plies;        // until the win or loss with best play, 0 for a draw
+  long nodes;       // positions looked at
+} SolverResult;
+
+bool solve_position(Rules *r, Position *p, Piece turn, long maxNodes, const Deadline *deadline, SolverResult *result);
+
+#endif /* SOLVER_H */
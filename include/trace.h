@@ -0,0 +1,48 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+  Search timeline in Chrome trace format (chrome://tracing, Perfetto).
+  Off unless open_trace is called. Every thread buffers its own events
+  and hands full buffers to a writer thread, so tracing takes no locks,
+  does no file I/O on the searching thread and costs little more than
+  reading the clock. Events that arrive while the writer is behind are
+  dropped, and their count goes in the trace's process metadata. Event
+  names and arg names must be string literals, only the pointer is kept.
+
+  close_trace flushes what's left in every thread's buffer, so it has to
+  wait until the threads that traced are done searching.
+*/
+
+// events a thread buffers before it hands them to the writer
+#define TRACE_BUFFER_EVENTS 4096
+
+bool open_trace(const char *path);
+void close_trace();
+bool is_tracing();
+
+uint64_t trace_now();
+void trace_complete(const char *name, uint64_t startUs, const char *argName, long arg);
+void trace_instant(const char *name, const char *argName, long arg);
+
+/*
+  Static tracepoints for perf and bpftrace at the phases of an MCTS
+  iteration. They compile to nothing unless libttt is built with
+  -DTTT_USDT, which needs <sys/sdt.h> (systemtap-sdt-dev):
+
+    make clean && make TRACE_FLAGS=-DTTT_USDT
+    perf probe -x ./ttt sdt_ttt:select
+*/
+#ifdef TTT_USDT
+#include <sys/sdt.h>
+#define TRACE_PROBE(name) DTRACE_PROBE(ttt, name)
+#define TRACE_PROBE1(name, a) DTRACE_PROBE1(ttt, name, a)
+#else
+#define TRACE_PROBE(name) do { } while (0)
+#define TRACE_PROBE1(name, a) do { (void)(a); } while (0)
+#endif
+
+#endif /* TRACE_H */
@@ -0,0 +1,22 @@
+#ifndef TTT_H
+#define TTT_H
+
+/*
+  libttt: the game rules and the search, with no ncurses or screen layout
+  in them. Headless programs only need this header and libttt; the
+  terminal UI (display.h) is built on top of it separately.
+*/
+
+#include "game.h"
+#include "alloc.h"
+#include "bitboard.h"
+#include "rules.h"
+#include "ai.h"
+#include "solver.h"
+#include "book.h"
+#include "cache.h"
+#include "record.h"
+#include "trace.h"
+#include "latency.h"
+
+#endif /* TTT_H */
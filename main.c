@@ -1,23 +1,112 @@
 #include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
 #include <ncurses.h>
 #include <locale.h>
+#include <unistd.h>
 
 #include "display.h"
 #include "game.h"
+#include "record.h"
+#include "book.h"
+#include "cache.h"
+#include "trace.h"
+
+static void usage(const char *prog) {
+  fprintf(stderr, "usage: %s [rows cols k | ultimate]\n", prog);
+  fprintf(stderr, "games are logged to $TTT_RECORDS (default ~/%s, empty to turn off)\n", DEFAULT_RECORD_FILE);
+  fprintf(stderr, "the CPU plays from the opening book in $TTT_BOOK, if set\n");
+  fprintf(stderr, "search statistics are kept between runs in $TTT_CACHE, if set\n");
+  fprintf(stderr, "a timeline of the CPU's searches is written to $TTT_TRACE, if set\n");
+  fprintf(stderr, "the CPU searches for as long as it can while replying within $TTT_LATENCY_MS milliseconds, if set\n");
+}
+
+int main(int argc, char **argv) {
+  int rows = 3;
+  int cols = 3;
+  int k = 3;
+  bool ultimate = false;
+
+  // ttt [rows cols k | ultimate]
+  if (argc == 2 && strcmp(argv[1], "ultimate") == 0) {
+    ultimate = true;
+  } else if (argc == 4) {
+    rows = atoi(argv[1]);
+    cols = atoi(argv[2]);
+    k = atoi(argv[3]);
+  } else if (argc != 1) {
+    usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  if (!is_valid_board_size(rows, cols, k)) {
+    fprintf(stderr, "boards can be up to %dx%d and k can't be longer than the board\n", MAX_BOARD_DIM, MAX_BOARD_DIM);
+    return EXIT_FAILURE;
+  }
+
+  if (ultimate) {
+    rows = ULTIMATE_SIZE;
+    cols = ULTIMATE_SIZE;
+    k = ULTIMATE_DIM;
+  }
+
+  const char *bookPath = getenv("TTT_BOOK");
+  if (bookPath != NULL && !load_opening_book(bookPath, ultimate ? GV_ULTIMATE : GV_STANDARD, rows, cols, k)) {
+    fprintf(stderr, "%s: not an opening book for this board\n", bookPath);
+    return EXIT_FAILURE;
+  }
+
+  const char *cachePath = getenv("TTT_CACHE");
+  if (cachePath != NULL && !open_stats_cache(cachePath, DEFAULT_CACHE_SLOT_BITS)) {
+    fprintf(stderr, "%s: can't open the statistics cache\n", cachePath);
+    return EXIT_FAILURE;
+  }
+
+  const char *tracePath = getenv("TTT_TRACE");
+  if (tracePath != NULL && !open_trace(tracePath)) {
+    perror(tracePath);
+    return EXIT_FAILURE;
+  }
+
+  int targetMs = 0;
+  const char *target = getenv("TTT_LATENCY_MS");
+  if (target != NULL && (targetMs = atoi(target)) <= 0) {
+    fprintf(stderr, "TTT_LATENCY_MS: not a number of milliseconds\n");
+    return EXIT_FAILURE;
+  }
+
+  ReplyLatency latency;
+  init_reply_latency(&latency, targetMs);
 
-int main() {
   setlocale(LC_ALL, "");
   init_display();
 
-  Game *g = new_game();
+  Game *g = ultimate ? new_ultimate_game() : new_game(rows, cols, k);
 
-  refresh_display(g);
+  // games are logged if the record file can be opened, and quietly not
+  // logged otherwise
+  const char *recordPath = get_record_path();
+  int recordFd = recordPath == NULL ? -1 : open_record_log(recordPath);
 
-  play(g);
+  play(g, recordFd, &latency);
 
   kill_display();
+  printf("CPU reply times:\n");
+  print_reply_latency(&latency, stdout);
 
+  if (recordFd >= 0) close(recordFd);
   destroy_game(g);
 
+  if (bookPath != NULL) {
+    long hits, misses;
+    get_opening_book_stats(&hits, &misses);
+    printf("opening book: %ld hits, %ld misses\n", hits, misses);
+    unload_opening_book();
+  }
+
+  // after destroy_game, which flushes the search tree into the cache
+  close_stats_cache();
+  close_trace();
+
   return 0;
-}
\ No newline at end of file
+}
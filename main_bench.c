@@ -0,0 +1,404 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <limits.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "game.h"
+#include "ai.h"
+
+/*
+  Performance regression gate. Runs a fixed set of engine benchmarks a
+  few times over and compares them with a baseline stored for this
+  machine (bench-<hostname>.baseline unless -b says otherwise):
+
+    playouts_7x7      iterations/s of one search on an empty 7x7 board
+    playouts_ultimate iterations/s of one search of ultimate
+    bytes_per_node    tree memory over live nodes after the 7x7 search
+    games_per_s       self-play games/s on 5x5, a fixed count per move
+    move_p99_ms       99th percentile wall time of those games' moves
+
+  The playout rates are timed in CPU time, so other load on the machine
+  moves them less. A metric regresses when its median is worse than the
+  baseline's by more than the threshold and the means differ by more
+  than twice the standard error of the difference, so one noisy run
+  can't fail the gate on its own. Exits 1 on any regression.
+
+  With no baseline yet, or with -w, the results are stored as the new
+  baseline instead.
+*/
+
+#define DEFAULT_BENCH_RUNS 5
+#define DEFAULT_THRESHOLD 10.
+#define MAX_BENCH_RUNS 100
+
+#define PLAYOUTS_7X7_ITERATIONS 1000
+#define PLAYOUTS_ULTIMATE_ITERATIONS 3000
+#define GAME_ITERATIONS 200
+#define GAMES_PER_RUN 2
+
+// the bench tree budget, so bytes_per_node doesn't depend on the default
+#define BENCH_TREE_MEMORY ((size_t)64 << 20)
+
+#define MAX_METRIC_NAME 32
+#define MAX_MOVES_PER_RUN (GAMES_PER_RUN * 25)
+
+typedef enum Metric {
+  METRIC_PLAYOUTS_7X7,
+  METRIC_PLAYOUTS_ULTIMATE,
+  METRIC_BYTES_PER_NODE,
+  METRIC_GAMES_PER_S,
+  METRIC_MOVE_P99_MS,
+  NUM_METRICS
+} Metric;
+
+typedef struct MetricInfo {
+  const char *name;
+  bool higherIsBetter;
+} MetricInfo;
+
+static const MetricInfo METRICS[NUM_METRICS] = {
+  { "playouts_7x7", true },
+  { "playouts_ultimate", true },
+  { "bytes_per_node", false },
+  { "games_per_s", true },
+  { "move_p99_ms", false }
+};
+
+typedef struct Summary {
+  double mean;
+  double stddev;
+  double median;
+  int runs;     // 0 if there's nothing to compare with
+} Summary;
+
+static void usage(const char *prog) {
+  fprintf(stderr, "usage: %s [-r runs] [-t threshold %%] [-b baseline file] [-w]\n", prog);
+}
+
+static double get_seconds(clockid_t clock) {
+  struct timespec ts;
+  clock_gettime(clock, &ts);
+
+  return ts.tv_sec + (ts.tv_nsec / 1e9);
+}
+
+static int compare_doubles(const void *a, const void *b) {
+  double x = *(const double*)a;
+  double y = *(const double*)b;
+
+  return x < y ? -1 : x > y ? 1 : 0;
+}
+
+/**
+ * @brief the value at the given fraction of the sorted samples, by the
+ * nearest rank
+ *
+ * @param samples sorted in place
+ * @param n
+ * @param fraction
+ * @return double
+ */
+static double get_percentile(double *samples, int n, double fraction) {
+  qsort(samples, n, sizeof(double), compare_doubles);
+
+  int rank = (int)ceil(fraction * n);
+  if (rank < 1) rank = 1;
+
+  return samples[rank - 1];
+}
+
+static void summarize(double *samples, int n, Summary *s) {
+  double sum = 0.;
+  for (int i = 0; i < n; i++) sum += samples[i];
+  s->mean = sum / n;
+
+  double sq = 0.;
+  for (int i = 0; i < n; i++) sq += (samples[i] - s->mean) * (samples[i] - s->mean);
+  s->stddev = n > 1 ? sqrt(sq / (n - 1)) : 0.;
+
+  s->median = get_percentile(samples, n, 0.5);
+  s->runs = n;
+}
+
+static void get_bench_params(Game *g, SearchParams *params) {
+  get_search_params(g, params);
+
+  // a fixed amount of work per search, however sure of its move it gets
+  params->earlyStopping = false;
+}
+
+/**
+ * @brief times one search of the empty board
+ *
+ * @param g
+ * @param iterations
+ * @param bytesPerNode set to the tree's bytes over its live nodes if not NULL
+ * @return double iterations per CPU second
+ */
+static double bench_playouts(Game *g, int iterations, double *bytesPerNode) {
+  SearchParams params;
+  SearchStats stats;
+
+  reset_game(g);
+  update_game_state(g);
+  destroy_search_tree(g);
+  get_bench_params(g, &params);
+
+  double start = get_seconds(CLOCK_THREAD_CPUTIME_ID);
+  search_position_with(g, &params, iterations, 0, &stats);
+  double elapsed = get_seconds(CLOCK_THREAD_CPUTIME_ID) - start;
+
+  if (bytesPerNode != NULL) {
+    Tree *t = (Tree*)g->tree;
+    *bytesPerNode = t->pool.liveNodes == 0 ? 0. : (double)t->pool.bytes / t->pool.liveNodes;
+  }
+
+  destroy_search_tree(g);
+
+  return elapsed > 0. ? stats.iterations / elapsed : 0.;
+}
+
+static bool is_finished(Game *g) {
+  return g->state == GS_END_TIE || g->state == GS_END_X || g->state == GS_END_O;
+}
+
+/**
+ * @brief plays self-play games on 5x5, keeping the tree from move to move
+ * the way the UI does
+ *
+ * @param moveMs filled with each move's wall time in ms
+ * @param numMoves set to the number of moves played
+ * @return double games per second
+ */
+static double bench_games(double *moveMs, int *numMoves) {
+  Game *g = new_game(5, 5, 4);
+  SearchParams params;
+  get_bench_params(g, &params);
+
+  *numMoves = 0;
+  double start = get_seconds(CLOCK_MONOTONIC);
+
+  for (int i = 0; i < GAMES_PER_RUN; i++) {
+    reset_game(g);
+    update_game_state(g);
+    destroy_search_tree(g);
+
+    for (int turn = 0; !is_finished(g) && *numMoves < MAX_MOVES_PER_RUN; turn++) {
+      SearchStats stats;
+
+      double moveStart = get_seconds(CLOCK_MONOTONIC);
+      int pos = search_position_with(g, &params, GAME_ITERATIONS, 0, &stats);
+      if (pos < 0) break;
+
+      place_game_piece(g, pos, turn % 2 == 0 ? PIECE_X : PIECE_O);
+      advance_search_tree(g, pos);
+      moveMs[(*numMoves)++] = (get_seconds(CLOCK_MONOTONIC) - moveStart) * 1000.;
+
+      update_game_state(g);
+    }
+  }
+
+  double elapsed = get_seconds(CLOCK_MONOTONIC) - start;
+  destroy_game(g);
+
+  return elapsed > 0. ? GAMES_PER_RUN / elapsed : 0.;
+}
+
+/**
+ * @brief runs every benchmark once
+ *
+ * @param results filled with one value per metric
+ */
+static void run_benchmarks(double results[NUM_METRICS]) {
+  Game *g = new_game(7, 7, 5);
+  results[METRIC_PLAYOUTS_7X7] = bench_playouts(g, PLAYOUTS_7X7_ITERATIONS, &results[METRIC_BYTES_PER_NODE]);
+  destroy_game(g);
+
+  g = new_ultimate_game();
+  results[METRIC_PLAYOUTS_ULTIMATE] = bench_playouts(g, PLAYOUTS_ULTIMATE_ITERATIONS, NULL);
+  destroy_game(g);
+
+  double moveMs[MAX_MOVES_PER_RUN];
+  int numMoves;
+  results[METRIC_GAMES_PER_S] = bench_games(moveMs, &numMoves);
+  results[METRIC_MOVE_P99_MS] = numMoves == 0 ? 0. : get_percentile(moveMs, numMoves, 0.99);
+}
+
+static Metric find_metric(const char *name) {
+  for (int m = 0; m < NUM_METRICS; m++) {
+    if (strcmp(METRICS[m].name, name) == 0) return m;
+  }
+
+  return NUM_METRICS;
+}
+
+/**
+ * @brief reads a baseline file. Metrics it doesn't have are left with 0 runs
+ *
+ * @param path
+ * @param baseline
+ * @return true if the file could be read
+ */
+static bool read_baseline(const char *path, Summary baseline[NUM_METRICS]) {
+  for (int m = 0; m < NUM_METRICS; m++) baseline[m].runs = 0;
+
+  FILE *f = fopen(path, "r");
+  if (f == NULL) return false;
+
+  char line[256];
+  while (fgets(line, sizeof(line), f) != NULL) {
+    char name[MAX_METRIC_NAME];
+    Summary s;
+
+    if (line[0] == '#') continue;
+    if (sscanf(line, "%31s %lf %lf %lf %d", name, &s.mean, &s.stddev, &s.median, &s.runs) != 5) continue;
+
+    Metric m = find_metric(name);
+    if (m != NUM_METRICS && s.runs > 0) baseline[m] = s;
+  }
+
+  fclose(f);
+
+  return true;
+}
+
+static bool write_baseline(const char *path, const char *host, Summary current[NUM_METRICS]) {
+  FILE *f = fopen(path, "w");
+  if (f == NULL) {
+    perror(path);
+    return false;
+  }
+
+  fprintf(f, "# ttt bench baseline for %s: metric mean stddev median runs\n", host);
+  for (int m = 0; m < NUM_METRICS; m++) {
+    fprintf(f, "%s %.6g %.6g %.6g %d\n", METRICS[m].name, current[m].mean, current[m].stddev, current[m].median, current[m].runs);
+  }
+
+  fclose(f);
+
+  return true;
+}
+
+/**
+ * @brief compares one metric with its baseline
+ *
+ * @param m
+ * @param base
+ * @param cur
+ * @param threshold percent a median may get worse by
+ * @param change set to the change in the median, in percent, positive
+ * for better
+ * @return const char* the verdict, "REGRESSED" if the gate should fail
+ */
+static const char *compare_metric(Metric m, Summary *base, Summary *cur, double threshold, double *change) {
+  *change = 0.;
+  if (base->runs == 0) return "new";
+  if (base->median == 0.) return "ok";
+
+  *change = (cur->median - base->median) / base->median * 100.;
+  if (!METRICS[m].higherIsBetter) *change = -*change;
+
+  double stderrDiff = sqrt((base->stddev * base->stddev / base->runs) + (cur->stddev * cur->stddev / cur->runs));
+  bool significant = fabs(cur->mean - base->mean) > 2. * stderrDiff;
+
+  if (*change < -threshold) return significant ? "REGRESSED" : "noisy";
+  if (*change > threshold && significant) return "improved";
+
+  return "ok";
+}
+
+int main(int argc, char **argv) {
+  int runs = DEFAULT_BENCH_RUNS;
+  double threshold = DEFAULT_THRESHOLD;
+  const char *path = NULL;
+  bool writeBaseline = false;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "r:t:b:wh")) != -1) {
+    switch (opt) {
+      case 'r':
+        runs = atoi(optarg);
+        break;
+      case 't':
+        threshold = atof(optarg);
+        break;
+      case 'b':
+        path = optarg;
+        break;
+      case 'w':
+        writeBaseline = true;
+        break;
+      default:
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+  }
+
+  if (runs < 1 || runs > MAX_BENCH_RUNS || threshold < 0.) {
+    usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  char host[HOST_NAME_MAX + 1] = "unknown";
+  gethostname(host, sizeof(host));
+  host[HOST_NAME_MAX] = '\0';
+
+  char defaultPath[HOST_NAME_MAX + 32];
+  if (path == NULL) {
+    snprintf(defaultPath, sizeof(defaultPath), "bench-%s.baseline", host);
+    path = defaultPath;
+  }
+
+  set_tree_memory_budget(BENCH_TREE_MEMORY);
+
+  static double samples[NUM_METRICS][MAX_BENCH_RUNS];
+  for (int r = 0; r < runs; r++) {
+    double results[NUM_METRICS];
+    run_benchmarks(results);
+
+    for (int m = 0; m < NUM_METRICS; m++) samples[m][r] = results[m];
+
+    fprintf(stderr, "run %d/%d done\n", r + 1, runs);
+  }
+
+  Summary current[NUM_METRICS];
+  for (int m = 0; m < NUM_METRICS; m++) summarize(samples[m], runs, &current[m]);
+
+  Summary baseline[NUM_METRICS];
+  bool haveBaseline = read_baseline(path, baseline);
+
+  printf("%-18s %12s %12s %10s %8s  %s\n", "metric", "baseline", "median", "stddev", "change", "verdict");
+
+  int regressions = 0;
+  for (int m = 0; m < NUM_METRICS; m++) {
+    double change;
+    const char *verdict = compare_metric(m, &baseline[m], &current[m], threshold, &change);
+    if (strcmp(verdict, "REGRESSED") == 0) regressions++;
+
+    if (baseline[m].runs == 0) {
+      printf("%-18s %12s %12.2f %10.2f %8s  %s\n", METRICS[m].name, "-", current[m].median, current[m].stddev, "-", verdict);
+    } else {
+      printf("%-18s %12.2f %12.2f %10.2f %+7.1f%%  %s\n", METRICS[m].name, baseline[m].median, current[m].median, current[m].stddev, change, verdict);
+    }
+  }
+
+  if (writeBaseline || !haveBaseline) {
+    if (!write_baseline(path, host, current)) return EXIT_FAILURE;
+    printf("baseline written to %s (%d runs)\n", path, runs);
+
+    return 0;
+  }
+
+  if (regressions > 0) {
+    printf("%d of %d metrics regressed by more than %.1f%% against %s\n", regressions, NUM_METRICS, threshold, path);
+    return EXIT_FAILURE;
+  }
+
+  printf("no regressions against %s (threshold %.1f%%, %d runs)\n", path, threshold, runs);
+
+  return 0;
+}
@@ -0,0 +1,284 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "game.h"
+#include "ai.h"
+#include "book.h"
+
+/*
+  Opening book builder. Walks every position reachable in the first -d
+  moves of a game (one per set of mirror images), searches each one for
+  -n iterations on a pool of worker threads, and writes the chosen moves
+  out as a book for probe_opening_book.
+*/
+
+#define DEFAULT_PLIES 4
+#define DEFAULT_BOOK_ITERATIONS 20000
+#define MAX_PLIES 16
+
+typedef struct BookLine {
+  uint64_t key;
+  int sym;                    // takes the position to its canonical form
+  int numMoves;
+  uint8_t moves[MAX_PLIES];   // how to get there from the empty board
+} BookLine;
+
+typedef struct Builder {
+  bool ultimate;
+  int rows;
+  int cols;
+  int k;
+  int plies;
+  int iterations;
+  int numThreads;
+
+  Rules rules;
+  BookLine *lines;
+  long numLines;
+  BookEntry *entries;         // entries[i] is filled in for lines[i]
+  atomic_long next;
+} Builder;
+
+static int compare_lines(const void *a, const void *b) {
+  uint64_t ka = ((const BookLine*)a)->key;
+  uint64_t kb = ((const BookLine*)b)->key;
+
+  return ka < kb ? -1 : ka > kb;
+}
+
+static int compare_entries(const void *a, const void *b) {
+  uint64_t ka = ((const BookEntry*)a)->key;
+  uint64_t kb = ((const BookEntry*)b)->key;
+
+  return ka < kb ? -1 : ka > kb;
+}
+
+static void replay_line(Builder *b, BookLine *l, Position *p) {
+  memset(p, 0, sizeof(Position));
+  p->target = -1;
+
+  for (int i = 0; i < l->numMoves; i++) {
+    play_move(&b->rules, p, geom_bit(&b->rules.geom, l->moves[i]), i % 2 == 0 ? PIECE_X : PIECE_O);
+  }
+}
+
+/**
+ * @brief collects the positions of the first plies moves of a game, one
+ * for each set of mirror images, breadth first. Decided positions are
+ * left out since there's nothing to search in them
+ *
+ * @param b
+ */
+static void collect_lines(Builder *b) {
+  long cap = 1024;
+  b->lines = malloc(sizeof(BookLine) * cap);
+  b->numLines = 0;
+
+  // the empty board
+  BookLine root;
+  memset(&root, 0, sizeof(root));
+  Position p;
+  replay_line(b, &root, &p);
+  root.key = get_canonical_key(&b->rules, &p, &root.sym);
+  b->lines[b->numLines++] = root;
+
+  long layerStart = 0;
+
+  for (int ply = 0; ply < b->plies - 1; ply++) {
+    long layerEnd = b->numLines;
+
+    for (long i = layerStart; i < layerEnd; i++) {
+      BookLine parent = b->lines[i];
+      replay_line(b, &parent, &p);
+
+      Bitboard moves;
+      get_legal_moves(&b->rules, &p, &moves);
+      get_unique_moves(&b->rules, &p, &moves);
+
+      while (!bb_is_empty(&moves)) {
+        int bit = bb_first_bit(&moves);
+        bb_unset(&moves, bit);
+
+        Position child = p;
+        if (play_move(&b->rules, &child, bit, ply % 2 == 0 ? PIECE_X : PIECE_O) != PIECE_EMPTY) continue;
+
+        Bitboard childMoves;
+        get_legal_moves(&b->rules, &child, &childMoves);
+        if (bb_is_empty(&childMoves)) continue;
+
+        if (b->numLines == cap) {
+          cap *= 2;
+          b->lines = realloc(b->lines, sizeof(BookLine) * cap);
+        }
+
+        BookLine *l = &b->lines[b->numLines++];
+        *l = parent;
+        l->moves[l->numMoves++] = geom_pos(&b->rules.geom, bit);
+        l->key = get_canonical_key(&b->rules, &child, &l->sym);
+      }
+    }
+
+    // different move orders reach the same positions, keep one of each
+    qsort(b->lines + layerEnd, b->numLines - layerEnd, sizeof(BookLine), compare_lines);
+
+    long kept = layerEnd;
+    for (long i = layerEnd; i < b->numLines; i++) {
+      if (kept > layerEnd && b->lines[kept - 1].key == b->lines[i].key) continue;
+      b->lines[kept++] = b->lines[i];
+    }
+
+    b->numLines = kept;
+    layerStart = layerEnd;
+  }
+}
+
+static void *worker(void *arg) {
+  Builder *b = (Builder*)arg;
+  Game *g = b->ultimate ? new_ultimate_game() : new_game(b->rows, b->cols, b->k);
+  Geometry *geom = &b->rules.geom;
+
+  while (true) {
+    long i = atomic_fetch_add(&b->next, 1);
+    if (i >= b->numLines) break;
+
+    BookLine *l = &b->lines[i];
+
+    reset_game(g);
+    for (int m = 0; m < l->numMoves; m++) {
+      place_game_piece(g, l->moves[m], m % 2 == 0 ? PIECE_X : PIECE_O);
+    }
+    update_game_state(g);
+
+    SearchStats stats;
+    search_position(g, b->iterations, &stats);
+
+    BookEntry *e = &b->entries[i];
+    e->key = l->key;
+    e->move = geom_pos(geom, transform_bit(&b->rules, l->sym, geom_bit(geom, stats.move)));
+    e->reserved = 0;
+    e->visits = stats.moveVisits;
+  }
+
+  destroy_game(g);
+
+  return NULL;
+}
+
+static bool write_book(Builder *b, const char *path) {
+  FILE *f = fopen(path, "wb");
+  if (f == NULL) return false;
+
+  BookHeader h;
+  memset(&h, 0, sizeof(h));
+  memcpy(h.magic, BOOK_MAGIC, 4);
+  h.version = BOOK_VERSION;
+  h.variant = b->rules.variant;
+  h.rows = b->rules.geom.rows;
+  h.cols = b->rules.geom.cols;
+  h.k = b->rules.geom.k;
+  h.count = b->numLines;
+
+  bool ok = fwrite(&h, sizeof(h), 1, f) == 1 && fwrite(b->entries, sizeof(BookEntry), b->numLines, f) == (size_t)b->numLines;
+
+  return fclose(f) == 0 && ok;
+}
+
+static void usage(const char *prog) {
+  fprintf(stderr, "usage: %s [-s rows,cols,k | -u] [-d plies] [-n iterations] [-j threads] -o file\n", prog);
+}
+
+int main(int argc, char **argv) {
+  Builder b;
+  memset(&b, 0, sizeof(b));
+  b.rows = 3;
+  b.cols = 3;
+  b.k = 3;
+  b.plies = DEFAULT_PLIES;
+  b.iterations = DEFAULT_BOOK_ITERATIONS;
+  b.numThreads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+  const char *path = NULL;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "s:ud:n:j:o:h")) != -1) {
+    switch (opt) {
+      case 's':
+        if (sscanf(optarg, "%d,%d,%d", &b.rows, &b.cols, &b.k) != 3) {
+          usage(argv[0]);
+          return EXIT_FAILURE;
+        }
+        break;
+      case 'u':
+        b.ultimate = true;
+        break;
+      case 'd':
+        b.plies = atoi(optarg);
+        break;
+      case 'n':
+        b.iterations = atoi(optarg);
+        break;
+      case 'j':
+        b.numThreads = atoi(optarg);
+        break;
+      case 'o':
+        path = optarg;
+        break;
+      default:
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+  }
+
+  if (b.ultimate) {
+    b.rows = ULTIMATE_SIZE;
+    b.cols = ULTIMATE_SIZE;
+    b.k = ULTIMATE_DIM;
+  }
+
+  if (path == NULL || b.plies < 1 || b.plies > MAX_PLIES || b.iterations < 1 || b.numThreads < 1 || !is_valid_board_size(b.rows, b.cols, b.k)) {
+    usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  init_rules(&b.rules, b.ultimate ? GV_ULTIMATE : GV_STANDARD, b.rows, b.cols, b.k);
+
+  struct timespec start, end;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  collect_lines(&b);
+  fprintf(stderr, "searching %ld positions for %d iterations each\n", b.numLines, b.iterations);
+
+  b.entries = calloc(b.numLines, sizeof(BookEntry));
+  atomic_init(&b.next, 0);
+
+  pthread_t *threads = malloc(sizeof(pthread_t) * b.numThreads);
+  for (int i = 0; i < b.numThreads; i++) {
+    pthread_create(&threads[i], NULL, worker, &b);
+  }
+  for (int i = 0; i < b.numThreads; i++) {
+    pthread_join(threads[i], NULL);
+  }
+  free(threads);
+
+  qsort(b.entries, b.numLines, sizeof(BookEntry), compare_entries);
+
+  if (!write_book(&b, path)) {
+    perror(path);
+    return EXIT_FAILURE;
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  double elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+  fprintf(stderr, "wrote %ld positions to %s in %.3fs\n", b.numLines, path, elapsed);
+
+  free(b.entries);
+  free(b.lines);
+
+  return 0;
+}
@@ -0,0 +1,542 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <ncurses.h>
+#include <locale.h>
+
+#include "display.h"
+#include "game.h"
+#include "ai.h"
+#include "record.h"
+#include "book.h"
+#include "cache.h"
+#include "trace.h"
+
+/*
+  Self-play dashboard. Tiles as many engine-vs-engine games as fit on the
+  screen (or -n of them) and keeps them all running on a pool of worker
+  threads.
+
+  Workers never wait on the screen: after every move they post a snapshot
+  of the board to a bounded lock-free queue and carry on. The main thread
+  drains the queue and repaints the boards that changed at most -f times a
+  second, with one refresh per frame. If the queue is full the snapshot is
+  dropped and counted; the next one for that board supersedes it anyway.
+
+  With -c the engines share a statistics cache (see cache.h). With -b
+  they play from an opening book, hits and misses are shown in the status
+  line. With -r every finished game is appended to a record file (see
+  record.h).
+
+  Each board's title shows its X wins, O wins and ties so far, then the
+  result of the game on screen once it's over.
+*/
+
+#define QUEUE_SIZE 1024         // must be a power of two
+#define DEFAULT_FPS 20
+#define DEFAULT_PAUSE_MS 1000
+#define TILE_GAP 4
+#define TILE_ORIGIN_ROW 2
+#define TILE_ORIGIN_COL 2
+
+typedef struct Snapshot {
+  int tile;
+  GameState state;
+  int results[3];               // X wins, O wins, ties so far on the tile
+  char pieces[MAX_SQUARES];
+  char colors[MAX_SQUARES];
+} Snapshot;
+
+typedef struct QueueCell {
+  atomic_size_t seq;            // tells producers and the consumer whose turn it is
+  Snapshot snap;
+} QueueCell;
+
+/*
+  Bounded multi-producer single-consumer ring. Each cell carries a
+  sequence number: a producer may fill cell i when its sequence equals
+  the claimed position, the consumer may read it once it's one past.
+*/
+typedef struct UpdateQueue {
+  QueueCell cells[QUEUE_SIZE];
+  atomic_size_t tail;           // next position a producer claims
+  size_t head;                  // next position the consumer reads
+  atomic_long dropped;
+} UpdateQueue;
+
+typedef struct Match {
+  Game *game;
+  GameRecord rec;
+  int results[3];
+  struct timespec endedAt;
+} Match;
+
+typedef struct Tile {
+  Board board;                  // the main thread's copy of the match's board
+  BoardView view;
+  GameState state;
+  int results[3];
+  bool dirty;
+} Tile;
+
+typedef struct Dashboard {
+  int rows;
+  int cols;
+  int k;
+  bool ultimate;
+  int iterations;
+  int numThreads;
+  int fps;
+  int pauseMs;
+  int recordFd;                 // -1 if games aren't logged
+
+  int numTiles;
+  Match *matches;               // owned by the workers, match i by worker i % numThreads
+  Tile *tiles;                  // owned by the main thread
+  UpdateQueue *queue;
+
+  atomic_bool stop;
+  atomic_long moves;
+  atomic_long games;
+} Dashboard;
+
+typedef struct Worker {
+  Dashboard *d;
+  int id;
+} Worker;
+
+static void init_queue(UpdateQueue *q) {
+  for (size_t i = 0; i < QUEUE_SIZE; i++) {
+    atomic_init(&q->cells[i].seq, i);
+  }
+
+  atomic_init(&q->tail, 0);
+  q->head = 0;
+  atomic_init(&q->dropped, 0);
+}
+
+/**
+ * @brief adds a snapshot to the queue without blocking
+ *
+ * @param q
+ * @param snap
+ * @return true if it was queued, false if the queue was full
+ */
+static bool queue_push(UpdateQueue *q, Snapshot *snap) {
+  size_t pos = atomic_load_explicit(&q->tail, memory_order_relaxed);
+  QueueCell *cell;
+
+  while (true) {
+    cell = &q->cells[pos & (QUEUE_SIZE - 1)];
+    size_t seq = atomic_load_explicit(&cell->seq, memory_order_acquire);
+    long diff = (long)seq - (long)pos;
+
+    if (diff == 0) {
+      if (atomic_compare_exchange_weak_explicit(&q->tail, &pos, pos + 1, memory_order_relaxed, memory_order_relaxed)) break;
+    } else if (diff < 0) {
+      return false;
+    } else {
+      pos = atomic_load_explicit(&q->tail, memory_order_relaxed);
+    }
+  }
+
+  cell->snap = *snap;
+  atomic_store_explicit(&cell->seq, pos + 1, memory_order_release);
+
+  return true;
+}
+
+/**
+ * @brief takes the oldest snapshot off the queue. Only the main thread
+ * may call this
+ *
+ * @param q
+ * @param snap
+ * @return true if there was one
+ */
+static bool queue_pop(UpdateQueue *q, Snapshot *snap) {
+  QueueCell *cell = &q->cells[q->head & (QUEUE_SIZE - 1)];
+  size_t seq = atomic_load_explicit(&cell->seq, memory_order_acquire);
+
+  if (seq != q->head + 1) return false;
+
+  *snap = cell->snap;
+  atomic_store_explicit(&cell->seq, q->head + QUEUE_SIZE, memory_order_release);
+  q->head++;
+
+  return true;
+}
+
+static bool is_game_over(Game *g) {
+  return g->state == GS_END_X || g->state == GS_END_O || g->state == GS_END_TIE;
+}
+
+static long elapsed_ms(struct timespec *since) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  return ((now.tv_sec - since->tv_sec) * 1000) + ((now.tv_nsec - since->tv_nsec) / 1000000);
+}
+
+static void post_snapshot(Dashboard *d, int tile) {
+  Match *m = &d->matches[tile];
+  Board *b = &m->game->board;
+  Snapshot snap;
+
+  snap.tile = tile;
+  snap.state = m->game->state;
+  memcpy(snap.results, m->results, sizeof(snap.results));
+
+  for (int i = 0; i < b->numSquares; i++) {
+    snap.pieces[i] = b->squares[i].piece;
+    snap.colors[i] = b->squares[i].color;
+  }
+
+  if (!queue_push(d->queue, &snap)) atomic_fetch_add(&d->queue->dropped, 1);
+}
+
+/**
+ * @brief plays one move of a match, or starts its next game once the
+ * finished one has been on screen long enough
+ *
+ * @param d
+ * @param tile
+ * @return true if anything happened
+ */
+static bool play_step(Dashboard *d, int tile) {
+  Match *m = &d->matches[tile];
+  Game *g = m->game;
+
+  if (is_game_over(g)) {
+    if (elapsed_ms(&m->endedAt) < d->pauseMs) return false;
+
+    reset_game(g);
+    update_game_state(g);
+    start_game_record(&m->rec, g, RE_MCTS, 0);
+  } else {
+    uint64_t thinkStart = get_clock_ms();
+    int pos = probe_opening_book(g);
+    if (pos < 0) pos = search_position(g, d->iterations, NULL);
+    m->rec.engineMs += (uint32_t)(get_clock_ms() - thinkStart);
+
+    place_game_piece(g, pos, get_next_turn(&g->board));
+    advance_search_tree(g, pos);
+    add_record_move(&m->rec, pos);
+    update_game_state(g);
+    atomic_fetch_add(&d->moves, 1);
+
+    if (is_game_over(g)) {
+      m->results[g->state == GS_END_X ? 0 : g->state == GS_END_O ? 1 : 2]++;
+      clock_gettime(CLOCK_MONOTONIC, &m->endedAt);
+      atomic_fetch_add(&d->games, 1);
+
+      if (d->recordFd >= 0) {
+        finish_game_record(&m->rec, g->state);
+        write_game_record(d->recordFd, &m->rec);
+      }
+    }
+  }
+
+  post_snapshot(d, tile);
+
+  return true;
+}
+
+static void *worker(void *arg) {
+  Worker *w = (Worker*)arg;
+  Dashboard *d = w->d;
+
+  while (!atomic_load(&d->stop)) {
+    bool played = false;
+
+    for (int tile = w->id; tile < d->numTiles; tile += d->numThreads) {
+      if (play_step(d, tile)) played = true;
+    }
+
+    // every game is showing its result, don't spin
+    if (!played) {
+      struct timespec nap = { 0, 10 * 1000000 };
+      nanosleep(&nap, NULL);
+    }
+  }
+
+  return NULL;
+}
+
+static int get_tile_width(Dashboard *d) {
+  return BOARD_WIDTH(d->cols) + TILE_GAP;
+}
+
+static int get_tile_height(Dashboard *d) {
+  // a title line above the grid and a blank one below
+  return BOARD_HEIGHT(d->rows) + 3;
+}
+
+/**
+ * @brief works out how many boards fit on the screen and where they go
+ *
+ * @param d
+ * @param requested 0 to fill the screen
+ */
+static void layout_tiles(Dashboard *d, int requested) {
+  int across = (COLS - TILE_ORIGIN_COL) / get_tile_width(d);
+  int down = (LINES - TILE_ORIGIN_ROW - 1) / get_tile_height(d);
+  int fit = across * down;
+
+  if (fit < 1) fit = 1;
+  if (across < 1) across = 1;
+
+  d->numTiles = requested > 0 && requested < fit ? requested : fit;
+  d->tiles = calloc(d->numTiles, sizeof(Tile));
+
+  for (int i = 0; i < d->numTiles; i++) {
+    Tile *t = &d->tiles[i];
+    int row = TILE_ORIGIN_ROW + ((i / across) * get_tile_height(d)) + 1;
+    int col = TILE_ORIGIN_COL + ((i % across) * get_tile_width(d));
+
+    init_board(&t->board, d->rows, d->cols, d->k);
+    t->state = GS_INIT;
+    t->dirty = true;
+    init_board_view(&t->view, row, col, d->ultimate ? ULTIMATE_DIM : 0);
+  }
+}
+
+static void apply_snapshot(Dashboard *d, Snapshot *snap) {
+  Tile *t = &d->tiles[snap->tile];
+
+  for (int i = 0; i < t->board.numSquares; i++) {
+    t->board.squares[i].piece = snap->pieces[i];
+    t->board.squares[i].color = snap->colors[i];
+  }
+
+  t->state = snap->state;
+  memcpy(t->results, snap->results, sizeof(t->results));
+  t->dirty = true;
+}
+
+static const char *get_state_text(GameState state) {
+  switch (state) {
+    case GS_END_X:
+      return "X";
+    case GS_END_O:
+      return "O";
+    case GS_END_TIE:
+      return "=";
+    default:
+      return "";
+  }
+}
+
+static void paint_tile(Dashboard *d, int i) {
+  Tile *t = &d->tiles[i];
+  char title[64];
+
+  snprintf(title, sizeof(title), "#%d %d-%d-%d %s", i + 1, t->results[0], t->results[1], t->results[2], get_state_text(t->state));
+  mvprintw(t->view.row - 1, t->view.col, "%-*.*s", get_tile_width(d) - 1, get_tile_width(d) - 1, title);
+
+  paint_board_view(&t->view, &t->board, NULL);
+  t->dirty = false;
+}
+
+static void paint_status(Dashboard *d, struct timespec *start) {
+  long moves = atomic_load(&d->moves);
+  long ms = elapsed_ms(start);
+  long hits, misses;
+  get_opening_book_stats(&hits, &misses);
+
+  move(0, TILE_ORIGIN_COL);
+  clrtoeol();
+  printw("%d boards  %ld games  %ld moves  %.0f moves/s  book %ld/%ld  %ld updates dropped  (q to quit)",
+    d->numTiles,
+    atomic_load(&d->games),
+    moves,
+    ms > 0 ? moves * 1000. / ms : 0.,
+    hits,
+    hits + misses,
+    atomic_load(&d->queue->dropped)
+  );
+}
+
+static void run(Dashboard *d) {
+  int frameMs = 1000 / d->fps;
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  timeout(frameMs);
+
+  while (true) {
+    int c = getch();
+    if (c == 'q' || c == 'Q') break;
+
+    // the board may have changed several times since the last frame,
+    // only the newest state gets painted
+    Snapshot snap;
+    while (queue_pop(d->queue, &snap)) {
+      apply_snapshot(d, &snap);
+    }
+
+    for (int i = 0; i < d->numTiles; i++) {
+      if (d->tiles[i].dirty) paint_tile(d, i);
+    }
+    paint_status(d, &start);
+
+    refresh();
+  }
+}
+
+static void usage(const char *prog) {
+  fprintf(stderr, "usage: %s [-n boards] [-j threads] [-i iterations] [-s rows,cols,k | -u] [-f fps] [-p pause ms] [-r record file] [-b book] [-c cache] [-t trace file]\n", prog);
+}
+
+int main(int argc, char **argv) {
+  Dashboard d;
+  memset(&d, 0, sizeof(d));
+  d.rows = 3;
+  d.cols = 3;
+  d.k = 3;
+  d.iterations = MAX_ITERATIONS;
+  d.numThreads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+  d.fps = DEFAULT_FPS;
+  d.pauseMs = DEFAULT_PAUSE_MS;
+  d.recordFd = -1;
+  int requested = 0;
+  const char *recordPath = NULL;
+  const char *bookPath = NULL;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "n:j:i:s:uf:p:r:b:c:t:h")) != -1) {
+    switch (opt) {
+      case 'n':
+        requested = atoi(optarg);
+        break;
+      case 'j':
+        d.numThreads = atoi(optarg);
+        break;
+      case 'i':
+        d.iterations = atoi(optarg);
+        break;
+      case 's':
+        if (sscanf(optarg, "%d,%d,%d", &d.rows, &d.cols, &d.k) != 3) {
+          usage(argv[0]);
+          return EXIT_FAILURE;
+        }
+        break;
+      case 'u':
+        d.ultimate = true;
+        break;
+      case 'f':
+        d.fps = atoi(optarg);
+        break;
+      case 'p':
+        d.pauseMs = atoi(optarg);
+        break;
+      case 'r':
+        recordPath = optarg;
+        break;
+      case 'c':
+        if (!open_stats_cache(optarg, DEFAULT_CACHE_SLOT_BITS)) {
+          fprintf(stderr, "%s: can't open the statistics cache\n", optarg);
+          return EXIT_FAILURE;
+        }
+        break;
+      case 'b':
+        bookPath = optarg;
+        break;
+      case 't':
+        if (!open_trace(optarg)) {
+          perror(optarg);
+          return EXIT_FAILURE;
+        }
+        break;
+      default:
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+  }
+
+  if (d.ultimate) {
+    d.rows = ULTIMATE_SIZE;
+    d.cols = ULTIMATE_SIZE;
+    d.k = ULTIMATE_DIM;
+  }
+
+  if (requested < 0 || d.iterations < 1 || d.numThreads < 1 || d.fps < 1 || d.fps > 1000 || d.pauseMs < 0 || !is_valid_board_size(d.rows, d.cols, d.k)) {
+    usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  // after the board is known, a book for another board is refused
+  if (bookPath != NULL && !load_opening_book(bookPath, d.ultimate ? GV_ULTIMATE : GV_STANDARD, d.rows, d.cols, d.k)) {
+    fprintf(stderr, "%s: not an opening book for this board\n", bookPath);
+    return EXIT_FAILURE;
+  }
+
+  if (recordPath != NULL) {
+    d.recordFd = open_record_log(recordPath);
+    if (d.recordFd < 0) {
+      perror(recordPath);
+      return EXIT_FAILURE;
+    }
+  }
+
+  setlocale(LC_ALL, "");
+  init_display();
+
+  d.queue = malloc(sizeof(UpdateQueue));
+  init_queue(d.queue);
+  atomic_init(&d.stop, false);
+  atomic_init(&d.moves, 0);
+  atomic_init(&d.games, 0);
+
+  layout_tiles(&d, requested);
+
+  d.matches = calloc(d.numTiles, sizeof(Match));
+  for (int i = 0; i < d.numTiles; i++) {
+    d.matches[i].game = d.ultimate ? new_ultimate_game() : new_game(d.rows, d.cols, d.k);
+    update_game_state(d.matches[i].game);
+    start_game_record(&d.matches[i].rec, d.matches[i].game, RE_MCTS, 0);
+  }
+
+  if (d.numThreads > d.numTiles) d.numThreads = d.numTiles;
+
+  pthread_t *threads = malloc(sizeof(pthread_t) * d.numThreads);
+  Worker *workers = malloc(sizeof(Worker) * d.numThreads);
+
+  for (int i = 0; i < d.numThreads; i++) {
+    workers[i].d = &d;
+    workers[i].id = i;
+    pthread_create(&threads[i], NULL, worker, &workers[i]);
+  }
+
+  run(&d);
+
+  atomic_store(&d.stop, true);
+  for (int i = 0; i < d.numThreads; i++) {
+    pthread_join(threads[i], NULL);
+  }
+
+  close_trace();
+  kill_display();
+
+  printf("%ld games, %ld moves, %ld updates dropped\n", atomic_load(&d.games), atomic_load(&d.moves), atomic_load(&d.queue->dropped));
+
+  for (int i = 0; i < d.numTiles; i++) {
+    destroy_game(d.matches[i].game);
+  }
+
+  free(workers);
+  free(threads);
+  free(d.matches);
+  free(d.tiles);
+  free(d.queue);
+  if (d.recordFd >= 0) close(d.recordFd);
+  unload_opening_book();
+  close_stats_cache();
+
+  return 0;
+}
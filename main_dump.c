@@ -0,0 +1,134 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+
+#include "game.h"
+#include "ai.h"
+
+/*
+  Search tree dump. Searches one position and writes the search tree
+  out for offline analysis, as a Graphviz digraph or as JSON lines (see
+  export_search_tree). Large trees can be cut down to the first few
+  plies or to the subtrees that got enough visits. The search runs all
+  its iterations, with the solver and early stopping off, since a solved
+  or stopped root would leave next to no tree to look at:
+
+    dump -s 7,7,5 -n 20000 -d 3 -v 50 | dot -Tsvg > tree.svg
+*/
+
+#define DEFAULT_DUMP_ITERATIONS 10000
+
+static void usage(const char *prog) {
+  fprintf(stderr, "usage: %s [-s rows,cols,k | -u] [-p board] [-n iterations] [-f dot|json] [-d plies] [-v min visits] [-m tree MB] [-o file]\n", prog);
+}
+
+int main(int argc, char **argv) {
+  int rows = 3;
+  int cols = 3;
+  int k = 3;
+  bool ultimate = false;
+  const char *board = NULL;
+  const char *outPath = NULL;
+  int iterations = DEFAULT_DUMP_ITERATIONS;
+  TreeFormat format = TF_DOT;
+  int maxDepth = -1;
+  int minVisits = 0;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "s:up:n:f:d:v:m:o:h")) != -1) {
+    switch (opt) {
+      case 's':
+        if (sscanf(optarg, "%d,%d,%d", &rows, &cols, &k) != 3) {
+          usage(argv[0]);
+          return EXIT_FAILURE;
+        }
+        break;
+      case 'u':
+        ultimate = true;
+        break;
+      case 'p':
+        board = optarg;
+        break;
+      case 'n':
+        iterations = atoi(optarg);
+        break;
+      case 'f':
+        if (strcmp(optarg, "dot") == 0) {
+          format = TF_DOT;
+        } else if (strcmp(optarg, "json") == 0) {
+          format = TF_JSON;
+        } else {
+          usage(argv[0]);
+          return EXIT_FAILURE;
+        }
+        break;
+      case 'd':
+        maxDepth = atoi(optarg);
+        break;
+      case 'v':
+        minVisits = atoi(optarg);
+        break;
+      case 'm':
+        if (atoi(optarg) < 0) {
+          usage(argv[0]);
+          return EXIT_FAILURE;
+        }
+        set_tree_memory_budget((size_t)atoi(optarg) << 20);
+        break;
+      case 'o':
+        outPath = optarg;
+        break;
+      default:
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+  }
+
+  if (iterations < 1 || maxDepth < -1 || minVisits < 0 || (ultimate && board != NULL) || !is_valid_board_size(rows, cols, k)) {
+    usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  Game *g = ultimate ? new_ultimate_game() : new_game(rows, cols, k);
+
+  if (board != NULL && !parse_board(&g->board, board)) {
+    fprintf(stderr, "%s: not a position on a %dx%d board\n", board, rows, cols);
+    destroy_game(g);
+    return EXIT_FAILURE;
+  }
+
+  update_game_state(g);
+  if (g->state != GS_PLAYER_TURN && g->state != GS_CPU_TURN) {
+    fprintf(stderr, "the game is already over\n");
+    destroy_game(g);
+    return EXIT_FAILURE;
+  }
+
+  FILE *out = stdout;
+  if (outPath != NULL) {
+    out = fopen(outPath, "w");
+    if (out == NULL) {
+      perror(outPath);
+      destroy_game(g);
+      return EXIT_FAILURE;
+    }
+  }
+
+  SearchParams params;
+  SearchStats stats;
+  get_search_params(g, &params);
+  params.solveEmpty = 0;
+  params.earlyStopping = false;
+  search_position_with(g, &params, iterations, 0, &stats);
+
+  long written = export_search_tree((Tree*)g->tree, out, format, maxDepth, minVisits);
+
+  fprintf(stderr, "bestmove %d, %d iterations, %ld of the tree's nodes written\n", stats.move, stats.iterations, written);
+
+  if (out != stdout) fclose(out);
+  destroy_game(g);
+
+  return 0;
+}
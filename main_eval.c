@@ -0,0 +1,369 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "game.h"
+#include "ai.h"
+#include "cache.h"
+#include "trace.h"
+
+/*
+  Batch position evaluator. Reads one board per line (one character per
+  square, see parse_board) from a file or stdin, evaluates the positions
+  on a pool of worker threads and writes the results in input order:
+
+    <board> <move> <value> <win>/<draw>/<loss> <move visits>/<root visits>
+
+  Only a fixed window of positions is in flight at a time, so memory use
+  doesn't depend on the size of the input.
+*/
+
+#define MAX_LINE (MAX_SQUARES + 2)
+#define WINDOW_PER_THREAD 4
+
+typedef enum Engine {
+  ENGINE_MCTS,
+  ENGINE_FIRST
+} Engine;
+
+typedef enum SlotState {
+  SLOT_FREE,
+  SLOT_PENDING,
+  SLOT_RUNNING,
+  SLOT_DONE
+} SlotState;
+
+typedef struct Slot {
+  SlotState state;
+  char line[MAX_LINE];
+  bool valid;
+  SearchStats stats;
+} Slot;
+
+typedef struct Evaluator {
+  Engine engine;
+  int iterations;
+  int rows;
+  int cols;
+  int k;
+  int numThreads;
+
+  pthread_mutex_t lock;
+  pthread_cond_t workReady;   // a slot became pending, or input ended
+  pthread_cond_t slotDone;    // a slot finished evaluating
+
+  size_t peakTreeBytes;       // biggest tree any position needed
+  long recycledNodes;
+  long savedIterations;
+  long budgetIterations;      // run plus saved, over the positions searched
+
+  Slot *slots;
+  int windowSize;
+  long nextToRun;             // sequence number of the next pending slot
+  long nextToRead;            // sequence number the next input line gets
+  bool inputDone;
+} Evaluator;
+
+static void evaluate_slot(Evaluator *e, Game *g, Slot *s) {
+  s->stats.move = -1;
+  s->stats.iterations = 0;
+  s->stats.savedIterations = 0;
+  s->stats.solved = false;
+  s->stats.rootVisits = 0;
+  s->stats.moveVisits = 0;
+  s->stats.value = 0.;
+  s->stats.win = 0.;
+  s->stats.draw = 0.;
+  s->stats.loss = 0.;
+  s->stats.treeBytes = 0;
+  s->stats.recycledNodes = 0;
+
+  s->valid = parse_board(&g->board, s->line);
+  if (!s->valid) return;
+
+  // each line is unrelated to the last, don't carry statistics over
+  destroy_search_tree(g);
+
+  if (get_winning_line(&g->board) != NO_WINNER) return;
+
+  switch (e->engine) {
+    case ENGINE_MCTS:
+      search_position(g, e->iterations, &s->stats);
+      break;
+    case ENGINE_FIRST:
+      s->stats.move = next_move(g);
+      break;
+  }
+}
+
+static void *worker(void *arg) {
+  Evaluator *e = (Evaluator*)arg;
+  Game *g = new_game(e->rows, e->cols, e->k);
+
+  pthread_mutex_lock(&e->lock);
+
+  while (true) {
+    while (e->nextToRun == e->nextToRead && !e->inputDone) {
+      pthread_cond_wait(&e->workReady, &e->lock);
+    }
+
+    if (e->nextToRun == e->nextToRead) break;
+
+    Slot *s = &e->slots[e->nextToRun % e->windowSize];
+    e->nextToRun++;
+    s->state = SLOT_RUNNING;
+
+    pthread_mutex_unlock(&e->lock);
+    evaluate_slot(e, g, s);
+    pthread_mutex_lock(&e->lock);
+
+    s->state = SLOT_DONE;
+    if (s->stats.treeBytes > e->peakTreeBytes) e->peakTreeBytes = s->stats.treeBytes;
+    e->recycledNodes += s->stats.recycledNodes;
+    e->savedIterations += s->stats.savedIterations;
+    e->budgetIterations += s->stats.iterations + s->stats.savedIterations;
+    pthread_cond_broadcast(&e->slotDone);
+  }
+
+  pthread_mutex_unlock(&e->lock);
+  destroy_game(g);
+
+  return NULL;
+}
+
+static void write_slot(Evaluator *e, Slot *s, FILE *out) {
+  if (!s->valid) {
+    fprintf(out, "%s invalid\n", s->line);
+  } else if (e->engine == ENGINE_FIRST) {
+    fprintf(out, "%s %d - - -\n", s->line, s->stats.move);
+  } else {
+    fprintf(out, "%s %d %.3f %.3f/%.3f/%.3f %d/%d\n", s->line, s->stats.move, s->stats.value, s->stats.win, s->stats.draw, s->stats.loss, s->stats.moveVisits, s->stats.rootVisits);
+  }
+}
+
+/**
+ * @brief writes out every finished slot at the head of the window, in
+ * input order. Must be called with the lock held
+ *
+ * @param e
+ * @param head sequence number of the oldest unwritten slot
+ * @param out
+ * @return long the new head
+ */
+static long flush_done(Evaluator *e, long head, FILE *out) {
+  while (head < e->nextToRead && e->slots[head % e->windowSize].state == SLOT_DONE) {
+    Slot *s = &e->slots[head % e->windowSize];
+    write_slot(e, s, out);
+    s->state = SLOT_FREE;
+    head++;
+  }
+
+  return head;
+}
+
+static void strip_line(char *line) {
+  size_t len = strlen(line);
+  while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r')) {
+    line[--len] = '\0';
+  }
+}
+
+static long run(Evaluator *e, FILE *in, FILE *out) {
+  pthread_t *threads = malloc(sizeof(pthread_t) * e->numThreads);
+  char line[MAX_LINE];
+  long head = 0;
+
+  for (int i = 0; i < e->numThreads; i++) {
+    pthread_create(&threads[i], NULL, worker, e);
+  }
+
+  while (fgets(line, sizeof(line), in) != NULL) {
+    // swallow the rest of an overlong line, it gets reported as invalid
+    if (strchr(line, '\n') == NULL && !feof(in)) {
+      int c;
+      while ((c = fgetc(in)) != EOF && c != '\n');
+    }
+    strip_line(line);
+    if (line[0] == '\0') continue;
+
+    pthread_mutex_lock(&e->lock);
+
+    // wait for room in the window, writing out results as they complete
+    head = flush_done(e, head, out);
+    while (e->nextToRead - head >= e->windowSize) {
+      pthread_cond_wait(&e->slotDone, &e->lock);
+      head = flush_done(e, head, out);
+    }
+
+    Slot *s = &e->slots[e->nextToRead % e->windowSize];
+    strcpy(s->line, line);
+    s->state = SLOT_PENDING;
+    e->nextToRead++;
+
+    pthread_cond_signal(&e->workReady);
+    pthread_mutex_unlock(&e->lock);
+  }
+
+  pthread_mutex_lock(&e->lock);
+  e->inputDone = true;
+  pthread_cond_broadcast(&e->workReady);
+
+  head = flush_done(e, head, out);
+  while (head < e->nextToRead) {
+    pthread_cond_wait(&e->slotDone, &e->lock);
+    head = flush_done(e, head, out);
+  }
+  pthread_mutex_unlock(&e->lock);
+
+  for (int i = 0; i < e->numThreads; i++) {
+    pthread_join(threads[i], NULL);
+  }
+  free(threads);
+
+  return head;
+}
+
+static void usage(const char *prog) {
+  fprintf(stderr, "usage: %s [-e mcts|first] [-n iterations] [-x] [-f robust|max-robust] [-r rave] [-j threads] [-s rows,cols,k] [-m tree MB] [-c cache] [-t trace file] [file]\n", prog);
+}
+
+int main(int argc, char **argv) {
+  Evaluator e;
+  e.engine = ENGINE_MCTS;
+  e.iterations = MAX_ITERATIONS;
+  e.numThreads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+  e.rows = 3;
+  e.cols = 3;
+  e.k = 3;
+  e.peakTreeBytes = 0;
+  e.recycledNodes = 0;
+  e.savedIterations = 0;
+  e.budgetIterations = 0;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "e:n:xf:r:j:s:m:c:t:h")) != -1) {
+    switch (opt) {
+      case 'e':
+        if (strcmp(optarg, "mcts") == 0) {
+          e.engine = ENGINE_MCTS;
+        } else if (strcmp(optarg, "first") == 0) {
+          e.engine = ENGINE_FIRST;
+        } else {
+          usage(argv[0]);
+          return EXIT_FAILURE;
+        }
+        break;
+      case 'n':
+        e.iterations = atoi(optarg);
+        break;
+      case 'x':
+        // run every search to its full budget
+        set_early_stopping(false);
+        break;
+      case 'f':
+        if (strcmp(optarg, "robust") == 0) {
+          set_final_selection(FS_ROBUST);
+        } else if (strcmp(optarg, "max-robust") == 0) {
+          set_final_selection(FS_MAX_ROBUST);
+        } else {
+          usage(argv[0]);
+          return EXIT_FAILURE;
+        }
+        break;
+      case 'r':
+        // 0 turns RAVE off
+        set_rave_equivalence(atof(optarg));
+        break;
+      case 'j':
+        e.numThreads = atoi(optarg);
+        break;
+      case 's':
+        if (sscanf(optarg, "%d,%d,%d", &e.rows, &e.cols, &e.k) != 3) {
+          usage(argv[0]);
+          return EXIT_FAILURE;
+        }
+        break;
+      case 'm':
+        if (atoi(optarg) < 0) {
+          usage(argv[0]);
+          return EXIT_FAILURE;
+        }
+        set_tree_memory_budget((size_t)atoi(optarg) << 20);
+        break;
+      case 'c':
+        if (!open_stats_cache(optarg, DEFAULT_CACHE_SLOT_BITS)) {
+          fprintf(stderr, "%s: can't open the statistics cache\n", optarg);
+          return EXIT_FAILURE;
+        }
+        break;
+      case 't':
+        if (!open_trace(optarg)) {
+          perror(optarg);
+          return EXIT_FAILURE;
+        }
+        break;
+      default:
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+  }
+
+  if (e.iterations < 1 || e.numThreads < 1 || !is_valid_board_size(e.rows, e.cols, e.k)) {
+    usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  FILE *in = stdin;
+  if (optind < argc) {
+    in = fopen(argv[optind], "r");
+    if (in == NULL) {
+      perror(argv[optind]);
+      return EXIT_FAILURE;
+    }
+  }
+
+  pthread_mutex_init(&e.lock, NULL);
+  pthread_cond_init(&e.workReady, NULL);
+  pthread_cond_init(&e.slotDone, NULL);
+  e.windowSize = e.numThreads * WINDOW_PER_THREAD;
+  e.slots = calloc(e.windowSize, sizeof(Slot));
+  e.nextToRun = 0;
+  e.nextToRead = 0;
+  e.inputDone = false;
+
+  struct timespec start, end;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  long count = run(&e, in, stdout);
+  close_trace();
+
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  double elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+  fprintf(stderr, "%ld positions in %.3fs (%.0f positions/sec, %d threads)\n", count, elapsed, elapsed > 0 ? count / elapsed : 0., e.numThreads);
+  if (e.engine == ENGINE_MCTS) {
+    fprintf(stderr, "peak tree size: %.1fMB, %ld nodes recycled\n", e.peakTreeBytes / (double)(1 << 20), e.recycledNodes);
+    fprintf(stderr, "early stopping saved %ld of %ld iterations\n", e.savedIterations, e.budgetIterations);
+  }
+
+  free(e.slots);
+  pthread_cond_destroy(&e.slotDone);
+  pthread_cond_destroy(&e.workReady);
+  pthread_mutex_destroy(&e.lock);
+
+  if (in != stdin) fclose(in);
+
+  if (is_stats_cache_open()) {
+    uint64_t hits, misses, dropped;
+    get_stats_cache_counts(&hits, &misses, &dropped);
+    fprintf(stderr, "statistics cache: %llu hits, %llu misses, %llu dropped\n", (unsigned long long)hits, (unsigned long long)misses, (unsigned long long)dropped);
+  }
+
+  close_stats_cache();
+
+  return 0;
+}
@@ -0,0 +1,437 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "game.h"
+#include "rules.h"
+
+/*
+  Game tree enumerator ("perft"). Plays out every legal game from a
+  position and counts the positions and finished games it passes
+  through, split across threads by the first move.
+
+  There are two move generators to enumerate with:
+
+    board   the Board functions the UI plays with: get_next_turn,
+            place_piece and get_winning_line
+    rules   the bitboard rules the search uses: get_legal_moves and
+            play_move
+
+  By default both run and their totals have to agree; from the empty 3x3
+  board they also have to match the known totals below. Either way the
+  positions per second make a raw move generation benchmark.
+*/
+
+// the full 3x3 game tree, root included
+#define KNOWN_NODES 549946L
+#define KNOWN_GAMES 255168L
+#define KNOWN_X_WINS 131184L
+#define KNOWN_O_WINS 77904L
+#define KNOWN_DRAWS 46080L
+
+typedef enum Generator {
+  GEN_BOARD,
+  GEN_RULES,
+  GEN_BOTH
+} Generator;
+
+typedef struct Counts {
+  long nodes;       // positions, the starting one included
+  long xWins;
+  long oWins;
+  long draws;
+  long open;        // positions cut off by the depth limit
+} Counts;
+
+typedef struct Perft {
+  bool ultimate;
+  int rows;
+  int cols;
+  int k;
+  int depth;
+  int numThreads;
+  bool divide;
+  Generator generator;
+
+  Game *game;       // the starting position
+  Rules rules;
+  Position start;
+
+  int rootMoves[MAX_SQUARES];
+  int numRootMoves;
+  Counts *rootCounts;   // one per root move
+  atomic_int next;
+} Perft;
+
+typedef struct Job {
+  Perft *p;
+  Generator generator;
+} Job;
+
+static void add_counts(Counts *total, Counts *c) {
+  total->nodes += c->nodes;
+  total->xWins += c->xWins;
+  total->oWins += c->oWins;
+  total->draws += c->draws;
+  total->open += c->open;
+}
+
+static long get_games(Counts *c) {
+  return c->xWins + c->oWins + c->draws;
+}
+
+static void count_winner(Counts *c, Piece winner) {
+  if (winner == PIECE_X) {
+    c->xWins++;
+  } else if (winner == PIECE_O) {
+    c->oWins++;
+  } else {
+    c->draws++;
+  }
+}
+
+/**
+ * @brief enumerates with the Board functions, placing and lifting pieces
+ * on one board
+ *
+ * @param b
+ * @param depth plies left to play
+ * @param c
+ */
+static void perft_board(Board *b, int depth, Counts *c) {
+  c->nodes++;
+
+  Line wl = get_winning_line(b);
+  if (wl != NO_WINNER) {
+    count_winner(c, get_winning_piece(b, wl));
+    return;
+  }
+
+  if (num_empty_squares(b) == 0) {
+    count_winner(c, PIECE_EMPTY);
+    return;
+  }
+
+  if (depth == 0) {
+    c->open++;
+    return;
+  }
+
+  Piece p = get_next_turn(b);
+
+  for (int i = 0; i < b->numSquares; i++) {
+    if (place_piece(b, i, p) != BPR_OK) continue;
+
+    perft_board(b, depth - 1, c);
+    b->squares[i].piece = PIECE_EMPTY;
+  }
+}
+
+/**
+ * @brief enumerates with the bitboard rules. play_move reports the win,
+ * so a position is only checked for one when it's the starting one
+ *
+ * @param r
+ * @param pos
+ * @param turn
+ * @param depth plies left to play
+ * @param c
+ */
+static void perft_rules(Rules *r, Position *pos, Piece turn, int depth, Counts *c) {
+  Bitboard moves;
+  get_legal_moves(r, pos, &moves);
+
+  if (bb_is_empty(&moves)) {
+    c->nodes++;
+    count_winner(c, PIECE_EMPTY);
+    return;
+  }
+
+  if (depth == 0) {
+    c->nodes++;
+    c->open++;
+    return;
+  }
+
+  c->nodes++;
+
+  Piece next = turn == PIECE_X ? PIECE_O : PIECE_X;
+
+  while (!bb_is_empty(&moves)) {
+    int bit = bb_first_bit(&moves);
+    bb_unset(&moves, bit);
+
+    Position child = *pos;
+    Piece winner = play_move(r, &child, bit, turn);
+
+    if (winner != PIECE_EMPTY) {
+      c->nodes++;
+      count_winner(c, winner);
+    } else {
+      perft_rules(r, &child, next, depth - 1, c);
+    }
+  }
+}
+
+static void *worker(void *arg) {
+  Job *job = (Job*)arg;
+  Perft *p = job->p;
+  // each worker plays on its own copy of the board
+  Board board = p->game->board;
+  Board *b = &board;
+
+  Piece turn = get_next_turn(b);
+
+  while (true) {
+    int i = atomic_fetch_add(&p->next, 1);
+    if (i >= p->numRootMoves) break;
+
+    int pos = p->rootMoves[i];
+    Counts *c = &p->rootCounts[i];
+
+    if (job->generator == GEN_BOARD) {
+      place_piece(b, pos, turn);
+      perft_board(b, p->depth - 1, c);
+      b->squares[pos].piece = PIECE_EMPTY;
+    } else {
+      Position child = p->start;
+      Piece winner = play_move(&p->rules, &child, geom_bit(&p->rules.geom, pos), turn);
+
+      if (winner != PIECE_EMPTY) {
+        c->nodes++;
+        count_winner(c, winner);
+      } else {
+        perft_rules(&p->rules, &child, turn == PIECE_X ? PIECE_O : PIECE_X, p->depth - 1, c);
+      }
+    }
+  }
+
+  return NULL;
+}
+
+/**
+ * @brief enumerates the tree below the starting position with one of the
+ * generators, one root move at a time on each thread
+ *
+ * @param p
+ * @param generator
+ * @param total
+ * @return double seconds taken
+ */
+static double run(Perft *p, Generator generator, Counts *total) {
+  memset(total, 0, sizeof(Counts));
+  memset(p->rootCounts, 0, sizeof(Counts) * p->numRootMoves);
+  atomic_init(&p->next, 0);
+
+  // the starting position itself
+  total->nodes = 1;
+
+  struct timespec start, end;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  Job job = { p, generator };
+  pthread_t *threads = malloc(sizeof(pthread_t) * p->numThreads);
+
+  for (int i = 0; i < p->numThreads; i++) {
+    pthread_create(&threads[i], NULL, worker, &job);
+  }
+  for (int i = 0; i < p->numThreads; i++) {
+    pthread_join(threads[i], NULL);
+  }
+  free(threads);
+
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  for (int i = 0; i < p->numRootMoves; i++) {
+    add_counts(total, &p->rootCounts[i]);
+  }
+
+  return (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+}
+
+static void print_counts(const char *label, Counts *c) {
+  printf("%s: %ld nodes, %ld games (%ld X, %ld O, %ld draws)", label, c->nodes, get_games(c), c->xWins, c->oWins, c->draws);
+  if (c->open > 0) printf(", %ld open", c->open);
+}
+
+static bool is_same_counts(Counts *a, Counts *b) {
+  return a->nodes == b->nodes && a->xWins == b->xWins && a->oWins == b->oWins && a->draws == b->draws && a->open == b->open;
+}
+
+/**
+ * @brief runs one generator and prints its totals, along with the totals
+ * for each root move if asked to
+ *
+ * @param p
+ * @param generator
+ * @param total
+ */
+static void run_generator(Perft *p, Generator generator, Counts *total) {
+  const char *name = generator == GEN_BOARD ? "board" : "rules";
+  double elapsed = run(p, generator, total);
+
+  if (p->divide) {
+    for (int i = 0; i < p->numRootMoves; i++) {
+      char label[32];
+      snprintf(label, sizeof(label), "%s %d", name, p->rootMoves[i]);
+      print_counts(label, &p->rootCounts[i]);
+      printf("\n");
+    }
+  }
+
+  print_counts(name, total);
+  printf(" in %.3fs (%.0f nodes/sec)\n", elapsed, elapsed > 0 ? total->nodes / elapsed : 0.);
+}
+
+/**
+ * @brief the starting position has to be playable: not won already, and
+ * with at least one move to split the work on
+ *
+ * @param p
+ * @return true if there is anything to enumerate
+ */
+static bool find_root_moves(Perft *p) {
+  Bitboard moves;
+
+  if (get_position_winner(&p->rules, &p->start) != PIECE_EMPTY) return false;
+
+  get_legal_moves(&p->rules, &p->start, &moves);
+  p->numRootMoves = 0;
+
+  while (!bb_is_empty(&moves)) {
+    int bit = bb_first_bit(&moves);
+    bb_unset(&moves, bit);
+    p->rootMoves[p->numRootMoves++] = geom_pos(&p->rules.geom, bit);
+  }
+
+  return p->numRootMoves > 0;
+}
+
+static bool is_empty_3x3(Perft *p) {
+  return !p->ultimate && p->rows == 3 && p->cols == 3 && p->k == 3 && num_empty_squares(&p->game->board) == 9 && p->depth >= 9;
+}
+
+static void usage(const char *prog) {
+  fprintf(stderr, "usage: %s [-s rows,cols,k | -u] [-p board] [-d plies] [-g board|rules|both] [-j threads] [-v]\n", prog);
+}
+
+int main(int argc, char **argv) {
+  Perft p;
+  memset(&p, 0, sizeof(p));
+  p.rows = 3;
+  p.cols = 3;
+  p.k = 3;
+  p.depth = -1;
+  p.numThreads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+  p.generator = GEN_BOTH;
+  const char *board = NULL;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "s:up:d:g:j:vh")) != -1) {
+    switch (opt) {
+      case 's':
+        if (sscanf(optarg, "%d,%d,%d", &p.rows, &p.cols, &p.k) != 3) {
+          usage(argv[0]);
+          return EXIT_FAILURE;
+        }
+        break;
+      case 'u':
+        p.ultimate = true;
+        break;
+      case 'p':
+        board = optarg;
+        break;
+      case 'd':
+        p.depth = atoi(optarg);
+        break;
+      case 'g':
+        if (strcmp(optarg, "board") == 0) {
+          p.generator = GEN_BOARD;
+        } else if (strcmp(optarg, "rules") == 0) {
+          p.generator = GEN_RULES;
+        } else if (strcmp(optarg, "both") == 0) {
+          p.generator = GEN_BOTH;
+        } else {
+          usage(argv[0]);
+          return EXIT_FAILURE;
+        }
+        break;
+      case 'j':
+        p.numThreads = atoi(optarg);
+        break;
+      case 'v':
+        p.divide = true;
+        break;
+      default:
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+  }
+
+  if (p.ultimate) {
+    p.rows = ULTIMATE_SIZE;
+    p.cols = ULTIMATE_SIZE;
+    p.k = ULTIMATE_DIM;
+
+    // the Board functions don't know the ultimate rules
+    if (p.generator == GEN_BOTH) p.generator = GEN_RULES;
+  }
+
+  if (p.numThreads < 1 || (p.ultimate && (board != NULL || p.generator == GEN_BOARD)) || !is_valid_board_size(p.rows, p.cols, p.k)) {
+    usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  p.game = p.ultimate ? new_ultimate_game() : new_game(p.rows, p.cols, p.k);
+  if (p.depth < 0 || p.depth > p.game->board.numSquares) p.depth = p.game->board.numSquares;
+
+  if (board != NULL && !parse_board(&p.game->board, board)) {
+    fprintf(stderr, "%s: not a position on a %dx%d board\n", board, p.rows, p.cols);
+    destroy_game(p.game);
+    return EXIT_FAILURE;
+  }
+
+  init_rules(&p.rules, p.ultimate ? GV_ULTIMATE : GV_STANDARD, p.rows, p.cols, p.k);
+  game_to_position(&p.rules, p.game, &p.start);
+
+  if (p.depth < 1 || !find_root_moves(&p)) {
+    fprintf(stderr, "nothing to enumerate\n");
+    destroy_game(p.game);
+    return EXIT_FAILURE;
+  }
+
+  p.rootCounts = calloc(p.numRootMoves, sizeof(Counts));
+
+  Counts boardTotal, rulesTotal;
+  bool ok = true;
+
+  if (p.generator != GEN_RULES) run_generator(&p, GEN_BOARD, &boardTotal);
+  if (p.generator != GEN_BOARD) run_generator(&p, GEN_RULES, &rulesTotal);
+
+  if (p.generator == GEN_BOTH && !is_same_counts(&boardTotal, &rulesTotal)) {
+    printf("MISMATCH: the board and rules generators disagree\n");
+    ok = false;
+  }
+
+  if (is_empty_3x3(&p)) {
+    Counts known = { KNOWN_NODES, KNOWN_X_WINS, KNOWN_O_WINS, KNOWN_DRAWS, 0 };
+    Counts *found = p.generator == GEN_RULES ? &rulesTotal : &boardTotal;
+
+    if (!is_same_counts(found, &known) || (p.generator == GEN_BOTH && !is_same_counts(&rulesTotal, &known))) {
+      printf("MISMATCH: expected %ld games (%ld X, %ld O, %ld draws)\n", KNOWN_GAMES, KNOWN_X_WINS, KNOWN_O_WINS, KNOWN_DRAWS);
+      ok = false;
+    } else {
+      printf("ok: matches the known 3x3 totals\n");
+    }
+  }
+
+  free(p.rootCounts);
+  destroy_game(p.game);
+
+  return ok ? 0 : EXIT_FAILURE;
+}
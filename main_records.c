@@ -0,0 +1,222 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "game.h"
+#include "record.h"
+
+/*
+  Reads a game record file (see record.h). By default it scans the whole
+  file and prints a summary per board type:
+
+    <variant> <rows>x<cols> k=<k>: <games> games, X <n> O <n> tie <n>
+      unfinished <n>, <avg> moves/game, <avg> ms engine time/game
+
+  -l lists every game instead, one per line:
+
+    <index> <rows>x<cols>/<k> <result> <engine> <duration ms> <engine ms> <moves,...>
+
+  -g n prints only game n, found through an offset index built by
+  hopping over the size prefixes.
+*/
+
+#define MAX_KINDS 64
+
+typedef struct Summary {
+  GameVariant variant;
+  int rows;
+  int cols;
+  int k;
+  long games;
+  long results[4];    // indexed by RecordResult
+  long moves;
+  long engineMs;
+} Summary;
+
+static const char *get_result_text(RecordResult result) {
+  switch (result) {
+    case RR_X:
+      return "X";
+    case RR_O:
+      return "O";
+    case RR_TIE:
+      return "tie";
+    default:
+      return "unfinished";
+  }
+}
+
+static const char *get_engine_text(RecordEngine engine) {
+  switch (engine) {
+    case RE_MCTS:
+      return "mcts";
+    case RE_FIRST:
+      return "first";
+    default:
+      return "none";
+  }
+}
+
+static void print_record(long index, GameRecord *r) {
+  printf("%ld %dx%d/%d %s %s %u %u ", index, r->rows, r->cols, r->k, get_result_text(r->result), get_engine_text(r->engine), r->durationMs, r->engineMs);
+
+  for (int i = 0; i < r->numMoves; i++) {
+    printf(i == 0 ? "%d" : ",%d", r->moves[i]);
+  }
+  printf("\n");
+}
+
+static Summary *find_summary(Summary *kinds, int *numKinds, GameRecord *r) {
+  for (int i = 0; i < *numKinds; i++) {
+    Summary *s = &kinds[i];
+    if (s->variant == r->variant && s->rows == r->rows && s->cols == r->cols && s->k == r->k) return s;
+  }
+
+  if (*numKinds == MAX_KINDS) return NULL;
+
+  Summary *s = &kinds[(*numKinds)++];
+  memset(s, 0, sizeof(Summary));
+  s->variant = r->variant;
+  s->rows = r->rows;
+  s->cols = r->cols;
+  s->k = r->k;
+
+  return s;
+}
+
+static long summarize(RecordFile *f, bool list) {
+  Summary kinds[MAX_KINDS];
+  int numKinds = 0;
+  long count = 0;
+  GameRecord r;
+
+  for (size_t off = RECORD_FILE_HEADER_SIZE; off < f->size; off = next_record_offset(f, off)) {
+    if (!read_game_record(f, off, &r)) {
+      fprintf(stderr, "bad record at offset %zu, stopping\n", off);
+      break;
+    }
+
+    if (list) print_record(count, &r);
+    count++;
+
+    Summary *s = find_summary(kinds, &numKinds, &r);
+    if (s == NULL) continue;
+
+    s->games++;
+    s->results[r.result <= RR_UNFINISHED ? r.result : RR_UNFINISHED]++;
+    s->moves += r.numMoves;
+    s->engineMs += r.engineMs;
+  }
+
+  if (list) return count;
+
+  for (int i = 0; i < numKinds; i++) {
+    Summary *s = &kinds[i];
+    printf("%s %dx%d k=%d: %ld games, X %ld O %ld tie %ld unfinished %ld, %.1f moves/game, %.1f ms engine time/game\n",
+      s->variant == GV_ULTIMATE ? "ultimate" : "standard",
+      s->rows,
+      s->cols,
+      s->k,
+      s->games,
+      s->results[RR_X],
+      s->results[RR_O],
+      s->results[RR_TIE],
+      s->results[RR_UNFINISHED],
+      (double)s->moves / s->games,
+      (double)s->engineMs / s->games
+    );
+  }
+
+  return count;
+}
+
+/**
+ * @brief builds the offset of every record in one pass over the size
+ * prefixes, without decoding anything
+ *
+ * @param f
+ * @param count set to the number of records
+ * @return size_t* offsets, to be freed by the caller
+ */
+static size_t *build_index(RecordFile *f, long *count) {
+  long cap = 1024;
+  size_t *offsets = malloc(sizeof(size_t) * cap);
+  *count = 0;
+
+  for (size_t off = RECORD_FILE_HEADER_SIZE; off < f->size; off = next_record_offset(f, off)) {
+    if (*count == cap) {
+      cap *= 2;
+      offsets = realloc(offsets, sizeof(size_t) * cap);
+    }
+    offsets[(*count)++] = off;
+  }
+
+  return offsets;
+}
+
+static void usage(const char *prog) {
+  fprintf(stderr, "usage: %s [-l | -g game] file\n", prog);
+}
+
+int main(int argc, char **argv) {
+  bool list = false;
+  long game = -1;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "lg:h")) != -1) {
+    switch (opt) {
+      case 'l':
+        list = true;
+        break;
+      case 'g':
+        game = atol(optarg);
+        break;
+      default:
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+  }
+
+  if (optind != argc - 1) {
+    usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  RecordFile *f = open_record_file(argv[optind]);
+  if (f == NULL) {
+    fprintf(stderr, "%s: not a record file\n", argv[optind]);
+    return EXIT_FAILURE;
+  }
+
+  struct timespec start, end;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  long count;
+
+  if (game >= 0) {
+    size_t *offsets = build_index(f, &count);
+    GameRecord r;
+
+    if (game < count && read_game_record(f, offsets[game], &r)) {
+      print_record(game, &r);
+    } else {
+      fprintf(stderr, "no game %ld, the file has %ld\n", game, count);
+    }
+
+    free(offsets);
+  } else {
+    count = summarize(f, list);
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  double elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+  fprintf(stderr, "%ld games, %zu bytes in %.3fs\n", count, f->size, elapsed);
+
+  close_record_file(f);
+
+  return 0;
+}
@@ -0,0 +1,690 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <signal.h>
+#include <errno.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "game.h"
+#include "ai.h"
+
+/*
+  Engine server. Listens on a unix domain socket (or a loopback TCP port)
+  and speaks a line protocol, one command per line:
+
+    new [board]         start a new game, optionally from a board string
+                        with one character per square
+    size <rows> <cols> <k>
+                        switch the session to a different board size
+    ultimate            switch the session to ultimate tic-tac-toe
+    move <pos>          play a move for the side to move
+    search <iterations> search the current position, replies with
+                        "bestmove <pos> value <v> wdl <w> <d> <l>
+                        visits <n>/<root>"
+    stop                cut the running search short, it replies early
+    stats               session and server counters
+    quit                close the session
+
+  Every connection is a session with its own Game and search handle, so
+  the search tree is reused from move to move. Commands are queued per session and sessions
+  are handed to a fixed pool of worker threads; one session's commands
+  always run in order, on one worker at a time.
+*/
+
+#define DEFAULT_SOCKET_PATH "/tmp/ttt.sock"
+#define DEFAULT_WORKERS 4
+#define MAX_SESSIONS 1024
+#define MAX_LINE (MAX_SQUARES + 32)
+#define MAX_PENDING 32
+
+// iterations between checks of the stop flag
+#define SEARCH_SLICE 256
+
+typedef struct Command {
+  char line[MAX_LINE];
+  bool tooLong;         // the client's line didn't fit, line is empty
+  long searchSeq;       // sequence number if this is a search, else 0
+} Command;
+
+typedef struct Session {
+  int fd;
+  Game *game;
+  Search *search;       // NULL until the first search of a game
+
+  pthread_mutex_t lock;
+  Command pending[MAX_PENDING];
+  int pendingHead;
+  int pendingCount;
+  bool overflowed;      // commands were dropped because the queue was full
+  bool scheduled;       // on the run queue or being run by a worker
+  bool closed;          // the client went away
+
+  long lastSearchSeq;   // only touched by the main thread
+  atomic_long stopSeq;  // searches with a sequence number <= this stop early
+
+  // only touched by the worker running the session
+  int movesPlayed;
+  int searches;
+  long iterations;
+
+  char inbuf[MAX_LINE];
+  int inLen;
+  bool inTooLong;       // the line being read has run past MAX_LINE
+
+  struct Session *nextRun;
+} Session;
+
+typedef struct Server {
+  int listenFd;
+  int numWorkers;
+  int rows;         // board size new sessions start with
+  int cols;
+  int k;
+
+  pthread_mutex_t lock;
+  pthread_cond_t runnable;
+  Session *runHead;
+  Session *runTail;
+  bool shuttingDown;
+
+  atomic_int activeSessions;
+  atomic_long totalSearches;
+} Server;
+
+static volatile sig_atomic_t quitRequested = 0;
+
+static void handle_signal(int sig) {
+  (void)sig;
+  quitRequested = 1;
+}
+
+static Session *new_session(Server *srv, int fd) {
+  Session *s = calloc(1, sizeof(Session));
+  s->fd = fd;
+  s->game = new_game(srv->rows, srv->cols, srv->k);
+  update_game_state(s->game);
+  pthread_mutex_init(&s->lock, NULL);
+  atomic_init(&s->stopSeq, 0);
+
+  return s;
+}
+
+static void drop_search(Session *s) {
+  if (s->search == NULL) return;
+
+  destroy_search(s->search);
+  s->search = NULL;
+}
+
+static void destroy_session(Server *srv, Session *s) {
+  close(s->fd);
+  drop_search(s);
+  destroy_game(s->game);
+  pthread_mutex_destroy(&s->lock);
+  free(s);
+  atomic_fetch_sub(&srv->activeSessions, 1);
+}
+
+static void reply(Session *s, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+static void reply(Session *s, const char *fmt, ...) {
+  char buf[256];
+  va_list args;
+  va_start(args, fmt);
+  int len = vsnprintf(buf, sizeof(buf) - 1, fmt, args);
+  va_end(args);
+
+  if (len < 0) return;
+  if (len > (int)sizeof(buf) - 2) len = sizeof(buf) - 2;
+  buf[len++] = '\n';
+
+  int sent = 0;
+  while (sent < len) {
+    ssize_t n = send(s->fd, buf + sent, len - sent, MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return;
+    sent += n;
+  }
+}
+
+static void schedule(Server *srv, Session *s) {
+  pthread_mutex_lock(&srv->lock);
+  s->nextRun = NULL;
+  if (srv->runTail == NULL) {
+    srv->runHead = s;
+  } else {
+    srv->runTail->nextRun = s;
+  }
+  srv->runTail = s;
+  pthread_cond_signal(&srv->runnable);
+  pthread_mutex_unlock(&srv->lock);
+}
+
+static bool is_game_over(Game *g) {
+  return g->state == GS_END_TIE || g->state == GS_END_X || g->state == GS_END_O;
+}
+
+/**
+ * @brief starts a new game, from the given board if there is one. A bad
+ * board is turned down before anything is reset, so the game in progress
+ * carries on
+ *
+ * @param s
+ * @param arg board string, NULL for an empty board
+ */
+static void cmd_new(Session *s, const char *arg) {
+  Game *g = s->game;
+
+  // an ultimate position can't be described by its squares alone
+  if (arg != NULL && g->variant == GV_ULTIMATE) {
+    reply(s, "error ultimate games start empty");
+    return;
+  }
+
+  Board board = g->board;
+  if (arg != NULL && !parse_board(&board, arg)) {
+    reply(s, "error invalid board");
+    return;
+  }
+
+  reset_game(g);
+  drop_search(s);
+  if (arg != NULL) g->board = board;
+
+  update_game_state(g);
+  s->movesPlayed = 0;
+
+  reply(s, "ok");
+}
+
+static void cmd_size(Session *s, char **save) {
+  char *rows = strtok_r(NULL, " \t", save);
+  char *cols = strtok_r(NULL, " \t", save);
+  char *k = strtok_r(NULL, " \t", save);
+
+  if (rows == NULL || cols == NULL || k == NULL || !is_valid_board_size(atoi(rows), atoi(cols), atoi(k))) {
+    reply(s, "error invalid size");
+    return;
+  }
+
+  drop_search(s);
+  destroy_game(s->game);
+  s->game = new_game(atoi(rows), atoi(cols), atoi(k));
+  update_game_state(s->game);
+  s->movesPlayed = 0;
+
+  reply(s, "ok");
+}
+
+static void cmd_ultimate(Session *s) {
+  drop_search(s);
+  destroy_game(s->game);
+  s->game = new_ultimate_game();
+  update_game_state(s->game);
+  s->movesPlayed = 0;
+
+  reply(s, "ok");
+}
+
+static void cmd_move(Session *s, const char *arg) {
+  Game *g = s->game;
+
+  if (arg == NULL) {
+    reply(s, "error missing position");
+    return;
+  }
+
+  if (is_game_over(g)) {
+    reply(s, "error game over");
+    return;
+  }
+
+  int pos = atoi(arg);
+  if (place_game_piece(g, pos, get_next_turn(&g->board)) != BPR_OK) {
+    reply(s, "error illegal move");
+    return;
+  }
+
+  if (s->search != NULL && !apply_search_move(s->search, pos)) drop_search(s);
+  update_game_state(g);
+  s->movesPlayed++;
+
+  reply(s, "ok");
+}
+
+static void cmd_search(Server *srv, Session *s, const char *arg, long seq) {
+  Game *g = s->game;
+
+  if (is_game_over(g)) {
+    reply(s, "error game over");
+    return;
+  }
+
+  int budget = arg == NULL ? (g->variant == GV_ULTIMATE ? ULTIMATE_ITERATIONS : MAX_ITERATIONS) : atoi(arg);
+  if (budget < 1) {
+    reply(s, "error invalid budget");
+    return;
+  }
+
+  if (s->search == NULL) s->search = new_search(g, NULL);
+
+  SearchStats stats;
+  int done = 0;
+
+  // search in slices so a stop request is noticed promptly
+  do {
+    int slice = budget - done < SEARCH_SLICE ? budget - done : SEARCH_SLICE;
+    done += step_search(s->search, slice);
+  } while (done < budget && !is_search_settled(s->search, budget - done) && atomic_load(&s->stopSeq) < seq);
+
+  get_search_move(s->search, &stats);
+
+  s->searches++;
+  s->iterations += done;
+  atomic_fetch_add(&srv->totalSearches, 1);
+
+  reply(s, "bestmove %d value %.3f wdl %.3f %.3f %.3f visits %d/%d", stats.move, stats.value, stats.win, stats.draw, stats.loss, stats.moveVisits, stats.rootVisits);
+}
+
+static void cmd_stats(Server *srv, Session *s) {
+  Tree *t = s->search == NULL ? NULL : s->search->tree;
+
+  reply(s, "stats moves %d searches %d iterations %ld rootvisits %d sessions %d workers %d totalsearches %ld",
+    s->movesPlayed,
+    s->searches,
+    s->iterations,
+    t == NULL ? 0 : t->root->visitCount,
+    atomic_load(&srv->activeSessions),
+    srv->numWorkers,
+    atomic_load(&srv->totalSearches)
+  );
+}
+
+static void run_command(Server *srv, Session *s, Command *c) {
+  if (c->tooLong) {
+    reply(s, "error line too long");
+    return;
+  }
+
+  char *save = NULL;
+  char *cmd = strtok_r(c->line, " \t", &save);
+  if (cmd == NULL) return;
+
+  if (strcmp(cmd, "size") == 0) {
+    cmd_size(s, &save);
+    return;
+  }
+
+  char *arg = strtok_r(NULL, " \t", &save);
+
+  if (strcmp(cmd, "ultimate") == 0) {
+    cmd_ultimate(s);
+  } else if (strcmp(cmd, "new") == 0) {
+    cmd_new(s, arg);
+  } else if (strcmp(cmd, "move") == 0) {
+    cmd_move(s, arg);
+  } else if (strcmp(cmd, "search") == 0) {
+    cmd_search(srv, s, arg, c->searchSeq);
+  } else if (strcmp(cmd, "stats") == 0) {
+    cmd_stats(srv, s);
+  } else {
+    reply(s, "error unknown command");
+  }
+}
+
+/**
+ * @brief runs every queued command for a session, then either releases
+ * the session or destroys it if its client has gone away. Searches
+ * queued by a closed session are stopped after their first slice
+ *
+ * @param srv
+ * @param s
+ */
+static void run_session(Server *srv, Session *s) {
+  Command c;
+
+  while (true) {
+    pthread_mutex_lock(&s->lock);
+
+    if (s->overflowed) {
+      s->overflowed = false;
+      pthread_mutex_unlock(&s->lock);
+      reply(s, "error queue full, commands dropped");
+      continue;
+    }
+
+    if (s->pendingCount == 0) {
+      bool closed = s->closed;
+      s->scheduled = false;
+      pthread_mutex_unlock(&s->lock);
+
+      if (closed) destroy_session(srv, s);
+      return;
+    }
+
+    c = s->pending[s->pendingHead];
+    s->pendingHead = (s->pendingHead + 1) % MAX_PENDING;
+    s->pendingCount--;
+    pthread_mutex_unlock(&s->lock);
+
+    run_command(srv, s, &c);
+  }
+}
+
+static void *worker(void *arg) {
+  Server *srv = (Server*)arg;
+
+  while (true) {
+    pthread_mutex_lock(&srv->lock);
+    while (srv->runHead == NULL && !srv->shuttingDown) {
+      pthread_cond_wait(&srv->runnable, &srv->lock);
+    }
+
+    if (srv->runHead == NULL) {
+      pthread_mutex_unlock(&srv->lock);
+      return NULL;
+    }
+
+    Session *s = srv->runHead;
+    srv->runHead = s->nextRun;
+    if (srv->runHead == NULL) srv->runTail = NULL;
+    pthread_mutex_unlock(&srv->lock);
+
+    run_session(srv, s);
+  }
+}
+
+/**
+ * @brief queues one line from the client. Called on the main thread
+ *
+ * @param srv
+ * @param s
+ * @param line shorter than MAX_LINE, NULL for a line that was too long,
+ * which is answered with an error in its turn
+ */
+static void enqueue_line(Server *srv, Session *s, const char *line) {
+  // stop is handled here, it has to reach a search that's already running
+  if (line != NULL && strcmp(line, "stop") == 0) {
+    atomic_store(&s->stopSeq, s->lastSearchSeq);
+    return;
+  }
+
+  long seq = 0;
+  if (line != NULL && strncmp(line, "search", 6) == 0) seq = ++s->lastSearchSeq;
+
+  pthread_mutex_lock(&s->lock);
+
+  if (s->pendingCount == MAX_PENDING) {
+    s->overflowed = true;
+  } else {
+    Command *c = &s->pending[(s->pendingHead + s->pendingCount) % MAX_PENDING];
+    c->tooLong = line == NULL;
+    if (line == NULL) {
+      c->line[0] = '\0';
+    } else {
+      memcpy(c->line, line, strlen(line) + 1);
+    }
+    c->searchSeq = seq;
+    s->pendingCount++;
+  }
+
+  bool wake = !s->scheduled;
+  s->scheduled = true;
+
+  pthread_mutex_unlock(&s->lock);
+
+  if (wake) schedule(srv, s);
+}
+
+/**
+ * @brief hands the session over to be destroyed. If a worker holds it,
+ * the worker destroys it once its current command finishes
+ *
+ * @param srv
+ * @param s
+ */
+static void close_session(Server *srv, Session *s) {
+  pthread_mutex_lock(&s->lock);
+  s->closed = true;
+  atomic_store(&s->stopSeq, s->lastSearchSeq);
+  bool owned = s->scheduled;
+  pthread_mutex_unlock(&s->lock);
+
+  if (!owned) destroy_session(srv, s);
+}
+
+/**
+ * @brief reads whatever the client sent and queues each complete line
+ *
+ * @param srv
+ * @param s
+ * @return false if the session should be closed
+ */
+static bool read_session(Server *srv, Session *s) {
+  char buf[512];
+  ssize_t n = read(s->fd, buf, sizeof(buf));
+
+  if (n < 0 && (errno == EINTR || errno == EAGAIN)) return true;
+  if (n <= 0) return false;
+
+  for (ssize_t i = 0; i < n; i++) {
+    char c = buf[i];
+
+    if (c == '\n') {
+      s->inbuf[s->inLen] = '\0';
+      if (s->inLen > 0 && s->inbuf[s->inLen - 1] == '\r') s->inbuf[s->inLen - 1] = '\0';
+
+      // the start of an overlong line isn't run, it could be a
+      // different command once cut short
+      if (s->inTooLong) {
+        enqueue_line(srv, s, NULL);
+      } else {
+        if (strcmp(s->inbuf, "quit") == 0) return false;
+        if (s->inbuf[0] != '\0') enqueue_line(srv, s, s->inbuf);
+      }
+
+      s->inLen = 0;
+      s->inTooLong = false;
+    } else if (s->inLen < MAX_LINE - 1) {
+      s->inbuf[s->inLen++] = c;
+    } else {
+      s->inTooLong = true;
+    }
+  }
+
+  return true;
+}
+
+static int listen_unix(const char *path) {
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0) return -1;
+
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+
+  unlink(path);
+  if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(fd, 64) < 0) {
+    close(fd);
+    return -1;
+  }
+
+  return fd;
+}
+
+static int listen_tcp(int port) {
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (fd < 0) return -1;
+
+  int yes = 1;
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+  if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(fd, 64) < 0) {
+    close(fd);
+    return -1;
+  }
+
+  return fd;
+}
+
+static void serve(Server *srv) {
+  static struct pollfd fds[MAX_SESSIONS + 1];
+  static Session *sessions[MAX_SESSIONS + 1];
+  int numFds = 1;
+
+  fds[0].fd = srv->listenFd;
+  fds[0].events = POLLIN;
+
+  while (!quitRequested) {
+    if (poll(fds, numFds, -1) < 0) {
+      if (errno == EINTR) continue;
+      perror("poll");
+      return;
+    }
+
+    for (int i = numFds - 1; i >= 1; i--) {
+      if (fds[i].revents == 0) continue;
+
+      if (!read_session(srv, sessions[i])) {
+        close_session(srv, sessions[i]);
+
+        // fill the hole with the last entry
+        numFds--;
+        fds[i] = fds[numFds];
+        sessions[i] = sessions[numFds];
+      }
+    }
+
+    if (fds[0].revents & POLLIN) {
+      int fd = accept(srv->listenFd, NULL, NULL);
+
+      if (fd >= 0 && numFds > MAX_SESSIONS) {
+        close(fd);
+      } else if (fd >= 0) {
+        fds[numFds].fd = fd;
+        fds[numFds].events = POLLIN;
+        fds[numFds].revents = 0;
+        sessions[numFds] = new_session(srv, fd);
+        atomic_fetch_add(&srv->activeSessions, 1);
+        numFds++;
+      }
+    }
+  }
+
+  for (int i = 1; i < numFds; i++) {
+    close_session(srv, sessions[i]);
+  }
+}
+
+static void usage(const char *prog) {
+  fprintf(stderr, "usage: %s [-u socket path | -p tcp port] [-j workers] [-s rows,cols,k]\n", prog);
+}
+
+int main(int argc, char **argv) {
+  const char *path = DEFAULT_SOCKET_PATH;
+  int port = 0;
+  int numWorkers = DEFAULT_WORKERS;
+  int rows = 3;
+  int cols = 3;
+  int k = 3;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "u:p:j:s:h")) != -1) {
+    switch (opt) {
+      case 'u':
+        path = optarg;
+        break;
+      case 'p':
+        port = atoi(optarg);
+        break;
+      case 'j':
+        numWorkers = atoi(optarg);
+        break;
+      case 's':
+        if (sscanf(optarg, "%d,%d,%d", &rows, &cols, &k) != 3) {
+          usage(argv[0]);
+          return EXIT_FAILURE;
+        }
+        break;
+      default:
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+  }
+
+  if (numWorkers < 1 || !is_valid_board_size(rows, cols, k)) {
+    usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  Server srv;
+  memset(&srv, 0, sizeof(srv));
+  srv.numWorkers = numWorkers;
+  srv.rows = rows;
+  srv.cols = cols;
+  srv.k = k;
+  srv.listenFd = port > 0 ? listen_tcp(port) : listen_unix(path);
+  pthread_mutex_init(&srv.lock, NULL);
+  pthread_cond_init(&srv.runnable, NULL);
+  atomic_init(&srv.activeSessions, 0);
+  atomic_init(&srv.totalSearches, 0);
+
+  if (srv.listenFd < 0) {
+    perror("listen");
+    return EXIT_FAILURE;
+  }
+
+  struct sigaction sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = handle_signal;
+  sigaction(SIGINT, &sa, NULL);
+  sigaction(SIGTERM, &sa, NULL);
+  signal(SIGPIPE, SIG_IGN);
+
+  pthread_t *threads = malloc(sizeof(pthread_t) * numWorkers);
+  for (int i = 0; i < numWorkers; i++) {
+    pthread_create(&threads[i], NULL, worker, &srv);
+  }
+
+  if (port > 0) {
+    fprintf(stderr, "listening on 127.0.0.1:%d with %d workers\n", port, numWorkers);
+  } else {
+    fprintf(stderr, "listening on %s with %d workers\n", path, numWorkers);
+  }
+
+  serve(&srv);
+
+  pthread_mutex_lock(&srv.lock);
+  srv.shuttingDown = true;
+  pthread_cond_broadcast(&srv.runnable);
+  pthread_mutex_unlock(&srv.lock);
+
+  for (int i = 0; i < numWorkers; i++) {
+    pthread_join(threads[i], NULL);
+  }
+  free(threads);
+
+  close(srv.listenFd);
+  if (port == 0) unlink(path);
+
+  pthread_cond_destroy(&srv.runnable);
+  pthread_mutex_destroy(&srv.lock);
+
+  return 0;
+}
@@ -1,27 +1,263 @@
 #include <stdlib.h>
-#include <ncurses.h>
-#include <locale.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <fcntl.h>
+#include <unistd.h>
 
-#include "game.h"
+#include "ttt.h"
+
+// a tree budget small enough for one search to fill it
+#define STEADY_TREE_MEMORY ((size_t)256 << 10)
+#define STEADY_ITERATIONS 500
+#define STEADY_GAMES 2
+
+// games on the default board and tree budget, played the way play() does
+#define PLAY_WARMUP_GAMES 2
+#define PLAY_GAMES 5
+#define PLAY_SEED 1
+
+// X to move has to block O's row at the last square, the last child to
+// be expanded
+#define BLOCK_BOARD "X.........X.........XOOO."
+#define BLOCK_SQUARE 24
+#define BLOCK_ITERATIONS 3000
+
+#define REPLY_TARGET_MS 100
+#define SLOW_REPLIES 5
+#define FAST_REPLIES 20
+
+static long allocCount = 0;
+
+static void *count_alloc(size_t size) {
+  allocCount++;
+  return malloc(size);
+}
+
+static void play_noui(Game *g) {
+  update_game_state(g);
+  print_board(&g->board, "Initial");
+
+  int pos = get_next_move(g);
+  printf("requested pos: %d\n", pos);
+  Piece p = get_next_turn(&g->board);
+  place_game_piece(g, pos, p);
+  advance_search_tree(g, pos);
+
+  update_game_state(g);
+  print_board(&g->board, "MCTS");
+}
+
+static bool is_game_over(Game *g) {
+  return g->state == GS_END_X || g->state == GS_END_O || g->state == GS_END_TIE;
+}
+
+/**
+ * @brief plays a game against itself the way play() does: search, place
+ * the piece, move the tree down, update the state
+ * 
+ * @param g 
+ */
+static void play_self(Game *g) {
+  reset_game(g);
+  update_game_state(g);
+
+  while (!is_game_over(g)) {
+    int pos = search_position(g, STEADY_ITERATIONS, NULL);
+    place_game_piece(g, pos, get_next_turn(&g->board));
+    advance_search_tree(g, pos);
+    update_game_state(g);
+  }
+}
+
+/**
+ * @brief checks that once a game has warmed the search tree up, whole
+ * games - searches, moves and new games - run without allocating
+ * 
+ * @return true if nothing was allocated after the warm-up game
+ */
+static bool check_steady_state() {
+  Game g;
+  init_game(&g, 5, 5, 4);
+
+  set_tree_memory_budget(STEADY_TREE_MEMORY);
+  set_alloc_hooks(count_alloc, NULL);
+
+  play_self(&g);
+  long warmup = allocCount;
+
+  allocCount = 0;
+  for (int i = 0; i < STEADY_GAMES; i++) {
+    play_self(&g);
+  }
+
+  printf("allocations: %ld warming up, %ld in the next %d games\n", warmup, allocCount, STEADY_GAMES);
+
+  release_game(&g);
+  set_alloc_hooks(NULL, NULL);
+
+  return allocCount == 0;
+}
+
+/**
+ * @brief plays a game the way play() does against a player who moves at
+ * random: the engine ponders while it waits, replies with get_next_move
+ * and the game is logged
+ * 
+ * @param g 
+ * @param seed 
+ * @param recordFd 
+ */
+static void play_like_ui(Game *g, unsigned int *seed, int recordFd) {
+  GameRecord rec;
+
+  reset_game(g);
+  update_game_state(g);
+  start_game_record(&rec, g, RE_MCTS, RF_HUMAN_X);
+
+  while (!is_game_over(g)) {
+    int pos;
+    Piece p;
+
+    if (g->state == GS_PLAYER_TURN) {
+      while (ponder(g));
+
+      do {
+        pos = rand_r(seed) % g->board.numSquares;
+      } while (g->board.squares[pos].piece != PIECE_EMPTY);
+      p = PIECE_X;
+    } else {
+      pos = get_next_move(g);
+      p = PIECE_O;
+    }
+
+    place_game_piece(g, pos, p);
+    advance_search_tree(g, pos);
+    add_record_move(&rec, pos);
+    update_game_state(g);
+  }
+
+  finish_game_record(&rec, g->state);
+  write_game_record(recordFd, &rec);
+}
+
+/**
+ * @brief checks the steady state where it matters, in play() on the
+ * default board with the default tree budget: once the first games have
+ * grown the tree's pool, later games allocate nothing
+ * 
+ * @return true if nothing was allocated after the warm-up games
+ */
+static bool check_play_steady_state() {
+  Game g;
+  init_game(&g, 3, 3, 3);
+
+  unsigned int seed = PLAY_SEED;
+  int recordFd = open("/dev/null", O_WRONLY);
+
+  set_tree_memory_budget(DEFAULT_TREE_MEMORY);
+  set_alloc_hooks(count_alloc, NULL);
+
+  allocCount = 0;
+  for (int i = 0; i < PLAY_WARMUP_GAMES; i++) {
+    play_like_ui(&g, &seed, recordFd);
+  }
+  long warmup = allocCount;
+
+  allocCount = 0;
+  for (int i = 0; i < PLAY_GAMES; i++) {
+    play_like_ui(&g, &seed, recordFd);
+  }
+
+  printf("play allocations: %ld warming up, %ld in the next %d games\n", warmup, allocCount, PLAY_GAMES);
+
+  release_game(&g);
+  set_alloc_hooks(NULL, NULL);
+  close(recordFd);
+
+  return allocCount == 0;
+}
+
+/**
+ * @brief checks that the search finds a move that isn't the first one
+ * it expands. With the solver and the win and block shortcuts off only
+ * the tree search can find it, and only if robust selection isn't locked
+ * onto the children that were visited first
+ * 
+ * @return true if the search blocked
+ */
+static bool check_late_best_move() {
+  Game g;
+  init_game(&g, 5, 5, 4);
+  parse_board(&g.board, BLOCK_BOARD);
+  update_game_state(&g);
+
+  SearchParams params;
+  SearchStats stats;
+  get_search_params(&g, &params);
+  params.solveEmpty = 0;
+  params.grabWins = false;
+  params.blockLosses = false;
+
+  int pos = search_position_with(&g, &params, BLOCK_ITERATIONS, 0, &stats);
+  printf("late best move: played %d (%d of %d visits), needed %d\n", pos, stats.moveVisits, stats.rootVisits, BLOCK_SQUARE);
+
+  release_game(&g);
+
+  return pos == BLOCK_SQUARE;
+}
+
+/**
+ * @brief checks that a run of slow replies keeps cutting the reply
+ * budget, and that fast replies afterwards bring it back to the target
+ * 
+ * @return true if the budget fell and then recovered
+ */
+static bool check_reply_budget() {
+  ReplyLatency l;
+  init_reply_latency(&l, REPLY_TARGET_MS);
+  bool ok = l.budgetMs == REPLY_TARGET_MS;
+
+  for (int i = 0; i < SLOW_REPLIES; i++) {
+    int before = l.budgetMs;
+    record_reply(&l, REPLY_TARGET_MS * 3 * 1000);
+    ok = ok && (l.budgetMs < before || l.budgetMs == 1);
+  }
+  int lowest = l.budgetMs;
+
+  for (int i = 0; i < FAST_REPLIES; i++) {
+    int before = l.budgetMs;
+    record_reply(&l, REPLY_TARGET_MS / 10 * 1000);
+    ok = ok && l.budgetMs >= before;
+  }
+
+  printf("reply budget: %dms after %d slow replies, %dms after %d fast ones\n", lowest, SLOW_REPLIES, l.budgetMs, FAST_REPLIES);
+
+  return ok && lowest < REPLY_TARGET_MS && l.budgetMs == REPLY_TARGET_MS && l.overTarget == SLOW_REPLIES;
+}
 
 int main() {
-  Game *g = new_game();
+  Game *g = new_game(3, 3, 3);
 
-  g->board->squares[0]->piece = PIECE_EMPTY;
-  g->board->squares[1]->piece = PIECE_EMPTY;
-  g->board->squares[2]->piece = PIECE_X;
+  g->board.squares[0].piece = PIECE_EMPTY;
+  g->board.squares[1].piece = PIECE_EMPTY;
+  g->board.squares[2].piece = PIECE_X;
 
-  g->board->squares[3]->piece = PIECE_EMPTY;
-  g->board->squares[4]->piece = PIECE_X;
-  g->board->squares[5]->piece = PIECE_EMPTY;
+  g->board.squares[3].piece = PIECE_EMPTY;
+  g->board.squares[4].piece = PIECE_X;
+  g->board.squares[5].piece = PIECE_EMPTY;
 
-  g->board->squares[6]->piece = PIECE_O;
-  g->board->squares[7]->piece = PIECE_O;
-  g->board->squares[8]->piece = PIECE_X;
+  g->board.squares[6].piece = PIECE_O;
+  g->board.squares[7].piece = PIECE_O;
+  g->board.squares[8].piece = PIECE_X;
 
   play_noui(g);
 
   destroy_game(g);
 
-  return 0;
-}
\ No newline at end of file
+  bool ok = check_steady_state();
+  ok = check_play_steady_state() && ok;
+  ok = check_late_best_move() && ok;
+  ok = check_reply_budget() && ok;
+
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,497 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <limits.h>
+#include <math.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "game.h"
+#include "ai.h"
+
+/*
+  Search parameter tuner. Plays headless self-play matches in which every
+  move gets the same amount of CPU time, so settings are compared on
+  strength per millisecond rather than per iteration.
+
+    -m grid   every combination of the GRID_ values below plays a match
+              against the board's default params
+    -m spsa   tunes exploration and the RAVE equivalence with SPSA: each
+              step plays a match between two nudged copies of the current
+              settings and moves them towards the winner
+
+  The best settings are then played against the defaults at less and less
+  time per move, to find the least time at which they're still as strong
+  as the defaults are with the full time.
+
+  Match scores are noisy, so a setting only counts as better, or a time
+  as holding, when its score clears the mark by SCORE_MARGIN standard
+  errors. The solver is off: it plays the endgame perfectly whatever the
+  params, which only adds draws.
+*/
+
+#define DEFAULT_ROWS 7
+#define DEFAULT_COLS 7
+#define DEFAULT_K 5
+#define DEFAULT_MOVE_MS 5
+#define DEFAULT_GAMES 100
+#define DEFAULT_SPSA_STEPS 40
+
+// standard errors a score has to clear a mark by
+#define SCORE_MARGIN 2.
+// a setting beats the defaults if it scores more than this
+#define BEAT_SCORE 0.5
+// a setting holds its strength while it scores at least this much
+#define HOLD_SCORE 0.4
+
+// SPSA works on the params scaled to [0, 1]
+#define SPSA_MAX_EXPLORATION 3.
+#define SPSA_MAX_RAVE 2000.
+#define SPSA_A 0.05
+#define SPSA_C 0.1
+
+static const double GRID_EXPLORATION[] = { 0.5, 0.8, 1.0, 1.41, 2.0 };
+static const double GRID_RAVE[] = { 0., 100., 300., 1000. };
+static const bool GRID_GRAB_WINS[] = { true, false, true };
+static const bool GRID_BLOCK_LOSSES[] = { true, true, false };
+
+#define GRID_SIZE(a) ((int)(sizeof(a) / sizeof((a)[0])))
+
+typedef enum TuneMode {
+  TUNE_GRID,
+  TUNE_SPSA
+} TuneMode;
+
+typedef struct Side {
+  SearchParams params;
+  int moveMs;
+} Side;
+
+typedef struct Match {
+  Side sides[2];              // sides[0] plays X in even games
+  int numGames;
+  atomic_int next;
+
+  // results for sides[0]
+  atomic_int wins;
+  atomic_int draws;
+  atomic_int losses;
+  atomic_long iterations[2];  // run by each side, over all of its moves
+  atomic_long moves[2];
+} Match;
+
+typedef struct Tuner {
+  bool ultimate;
+  int rows;
+  int cols;
+  int k;
+  int moveMs;
+  int numGames;
+  int numThreads;
+  int spsaSteps;
+  TuneMode mode;
+
+  SearchParams defaults;
+} Tuner;
+
+typedef struct MatchWorker {
+  Tuner *tuner;
+  Match *match;
+} MatchWorker;
+
+static Game *new_tuner_game(Tuner *t) {
+  return t->ultimate ? new_ultimate_game() : new_game(t->rows, t->cols, t->k);
+}
+
+static bool is_finished(Game *g) {
+  return g->state == GS_END_TIE || g->state == GS_END_X || g->state == GS_END_O;
+}
+
+/**
+ * @brief plays one game of the match. The sides swap colors every game
+ * so neither gets the first move more often
+ *
+ * @param m
+ * @param g
+ * @param gameNum
+ */
+static void play_match_game(Match *m, Game *g, int gameNum) {
+  int first = gameNum % 2;    // the side playing X
+
+  reset_game(g);
+  update_game_state(g);
+
+  for (int turn = 0; !is_finished(g); turn++) {
+    int side = (first + turn) % 2;
+    Side *s = &m->sides[side];
+    SearchStats stats;
+
+    // each side searches from scratch, a shared tree would pool their work
+    destroy_search_tree(g);
+    int pos = search_position_with(g, &s->params, INT_MAX, s->moveMs, &stats);
+    if (pos < 0) break;
+
+    place_game_piece(g, pos, turn % 2 == 0 ? PIECE_X : PIECE_O);
+    update_game_state(g);
+
+    atomic_fetch_add(&m->iterations[side], stats.iterations);
+    atomic_fetch_add(&m->moves[side], 1);
+  }
+
+  destroy_search_tree(g);
+
+  Piece winner = g->state == GS_END_X ? PIECE_X : g->state == GS_END_O ? PIECE_O : PIECE_EMPTY;
+  Piece firstPiece = first == 0 ? PIECE_X : PIECE_O;
+
+  if (winner == PIECE_EMPTY) {
+    atomic_fetch_add(&m->draws, 1);
+  } else if (winner == firstPiece) {
+    atomic_fetch_add(&m->wins, 1);
+  } else {
+    atomic_fetch_add(&m->losses, 1);
+  }
+}
+
+static void *match_worker(void *arg) {
+  MatchWorker *w = (MatchWorker*)arg;
+  Game *g = new_tuner_game(w->tuner);
+
+  while (true) {
+    int i = atomic_fetch_add(&w->match->next, 1);
+    if (i >= w->match->numGames) break;
+
+    play_match_game(w->match, g, i);
+  }
+
+  destroy_game(g);
+
+  return NULL;
+}
+
+/**
+ * @brief plays a match between two sides on the tuner's worker threads
+ *
+ * @param t
+ * @param m sides and numGames filled in, the results are written back
+ * @return double the score of sides[0], a draw counting half
+ */
+static double play_match(Tuner *t, Match *m) {
+  atomic_init(&m->next, 0);
+  atomic_init(&m->wins, 0);
+  atomic_init(&m->draws, 0);
+  atomic_init(&m->losses, 0);
+  for (int i = 0; i < 2; i++) {
+    atomic_init(&m->iterations[i], 0);
+    atomic_init(&m->moves[i], 0);
+  }
+
+  MatchWorker w = { t, m };
+  pthread_t *threads = malloc(sizeof(pthread_t) * t->numThreads);
+
+  for (int i = 0; i < t->numThreads; i++) {
+    pthread_create(&threads[i], NULL, match_worker, &w);
+  }
+  for (int i = 0; i < t->numThreads; i++) {
+    pthread_join(threads[i], NULL);
+  }
+  free(threads);
+
+  return (atomic_load(&m->wins) + (0.5 * atomic_load(&m->draws))) / m->numGames;
+}
+
+/**
+ * @brief the standard error of a match score, from the spread of the
+ * game results around it
+ *
+ * @param m
+ * @param score
+ * @return double
+ */
+static double get_score_error(Match *m, double score) {
+  int wins = atomic_load(&m->wins);
+  int draws = atomic_load(&m->draws);
+  int losses = atomic_load(&m->losses);
+
+  double variance = ((wins * (1. - score) * (1. - score)) + (draws * (0.5 - score) * (0.5 - score)) + (losses * score * score)) / m->numGames;
+
+  return sqrt(variance / m->numGames);
+}
+
+/**
+ * @brief whether a match score is above a mark by more than the noise
+ *
+ * @param m
+ * @param score
+ * @param mark
+ * @return true if the score less SCORE_MARGIN standard errors is still
+ * at least the mark
+ */
+static bool is_clear_of(Match *m, double score, double mark) {
+  return score - (SCORE_MARGIN * get_score_error(m, score)) >= mark;
+}
+
+static double get_iterations_per_move(Match *m, int side) {
+  long moves = atomic_load(&m->moves[side]);
+
+  return moves == 0 ? 0. : (double)atomic_load(&m->iterations[side]) / moves;
+}
+
+static void print_params(SearchParams *p) {
+  printf("exploration %.3f rave %.0f playouts %s solve %d", p->exploration, p->raveEquivalence,
+    p->grabWins && p->blockLosses ? "wins+blocks" : p->grabWins ? "wins" : p->blockLosses ? "blocks" : "random", p->solveEmpty);
+}
+
+static void print_result(SearchParams *p, Match *m, double score) {
+  print_params(p);
+  printf(": score %.3f +- %.3f (%d-%d-%d) %.0f iterations/move\n", score, get_score_error(m, score), atomic_load(&m->wins), atomic_load(&m->draws), atomic_load(&m->losses), get_iterations_per_move(m, 0));
+  fflush(stdout);
+}
+
+/**
+ * @brief plays every combination of the grid values against the defaults
+ *
+ * @param t
+ * @param best set to the best scoring params that clearly beat the
+ * defaults, left alone if none did
+ */
+static void tune_grid(Tuner *t, SearchParams *best) {
+  double bestScore = BEAT_SCORE;
+
+  for (int e = 0; e < GRID_SIZE(GRID_EXPLORATION); e++) {
+    for (int r = 0; r < GRID_SIZE(GRID_RAVE); r++) {
+      for (int h = 0; h < GRID_SIZE(GRID_GRAB_WINS); h++) {
+        Match m;
+        m.numGames = t->numGames;
+        m.sides[0].params = t->defaults;
+        m.sides[0].params.exploration = GRID_EXPLORATION[e];
+        m.sides[0].params.raveEquivalence = GRID_RAVE[r];
+        m.sides[0].params.grabWins = GRID_GRAB_WINS[h];
+        m.sides[0].params.blockLosses = GRID_BLOCK_LOSSES[h];
+        m.sides[0].moveMs = t->moveMs;
+        m.sides[1].params = t->defaults;
+        m.sides[1].moveMs = t->moveMs;
+
+        double score = play_match(t, &m);
+        print_result(&m.sides[0].params, &m, score);
+
+        if (score > bestScore && is_clear_of(&m, score, BEAT_SCORE)) {
+          bestScore = score;
+          *best = m.sides[0].params;
+        }
+      }
+    }
+  }
+}
+
+static double clamp_unit(double x) {
+  return x < 0. ? 0. : x > 1. ? 1. : x;
+}
+
+static void set_spsa_params(SearchParams *p, const double theta[2]) {
+  p->exploration = clamp_unit(theta[0]) * SPSA_MAX_EXPLORATION;
+  p->raveEquivalence = clamp_unit(theta[1]) * SPSA_MAX_RAVE;
+}
+
+/**
+ * @brief tunes exploration and the RAVE equivalence with simultaneous
+ * perturbation stochastic approximation. Each step nudges both params
+ * by +-c at random, plays the two nudged copies against each other and
+ * moves the params along the difference in their scores. The match
+ * results are noisy, the shrinking step sizes average it out. Where the
+ * params end up is then played against the defaults
+ *
+ * @param t
+ * @param best set to where the params ended up if they clearly beat the
+ * defaults, left alone if not
+ */
+static void tune_spsa(Tuner *t, SearchParams *best) {
+  double theta[2] = {
+    clamp_unit(t->defaults.exploration / SPSA_MAX_EXPLORATION),
+    clamp_unit(t->defaults.raveEquivalence / SPSA_MAX_RAVE)
+  };
+  unsigned int seed = (unsigned int)time(NULL);
+  SearchParams tuned = t->defaults;
+
+  for (int step = 0; step < t->spsaSteps; step++) {
+    double a = SPSA_A / pow(step + 1 + (t->spsaSteps / 10.), 0.602);
+    double c = SPSA_C / pow(step + 1, 0.101);
+    double delta[2], plus[2], minus[2];
+
+    for (int i = 0; i < 2; i++) {
+      delta[i] = rand_r(&seed) % 2 == 0 ? -1. : 1.;
+      plus[i] = theta[i] + (c * delta[i]);
+      minus[i] = theta[i] - (c * delta[i]);
+    }
+
+    Match m;
+    m.numGames = t->numGames;
+    m.sides[0].params = t->defaults;
+    m.sides[0].moveMs = t->moveMs;
+    m.sides[1].params = t->defaults;
+    m.sides[1].moveMs = t->moveMs;
+    set_spsa_params(&m.sides[0].params, plus);
+    set_spsa_params(&m.sides[1].params, minus);
+
+    double score = play_match(t, &m);
+
+    // the minus side scored 1 - score, so the difference is 2 * score - 1
+    for (int i = 0; i < 2; i++) {
+      theta[i] = clamp_unit(theta[i] + (a * ((2. * score) - 1.) / (2. * c * delta[i])));
+    }
+
+    set_spsa_params(&tuned, theta);
+    printf("step %d: ", step + 1);
+    print_params(&tuned);
+    printf(" (last match %.3f)\n", score);
+    fflush(stdout);
+  }
+
+  Match m;
+  m.numGames = t->numGames;
+  m.sides[0].params = tuned;
+  m.sides[0].moveMs = t->moveMs;
+  m.sides[1].params = t->defaults;
+  m.sides[1].moveMs = t->moveMs;
+
+  double score = play_match(t, &m);
+  print_result(&tuned, &m, score);
+
+  if (is_clear_of(&m, score, BEAT_SCORE)) *best = tuned;
+}
+
+/**
+ * @brief halves the time per move of the best params for as long as they
+ * still clearly hold their own against the defaults at the full time
+ *
+ * @param t
+ * @param best
+ * @return int the least time per move that held, in ms
+ */
+static int find_fastest_time(Tuner *t, SearchParams *best) {
+  int held = t->moveMs;
+
+  for (int ms = t->moveMs; ms >= 1; ms /= 2) {
+    Match m;
+    m.numGames = t->numGames;
+    m.sides[0].params = *best;
+    m.sides[0].moveMs = ms;
+    m.sides[1].params = t->defaults;
+    m.sides[1].moveMs = t->moveMs;
+
+    double score = play_match(t, &m);
+    printf("%dms/move against the defaults at %dms: score %.3f +- %.3f (%d-%d-%d) %.0f iterations/move\n", ms, t->moveMs, score, get_score_error(&m, score), atomic_load(&m.wins), atomic_load(&m.draws), atomic_load(&m.losses), get_iterations_per_move(&m, 0));
+    fflush(stdout);
+
+    if (!is_clear_of(&m, score, HOLD_SCORE)) break;
+    held = ms;
+  }
+
+  return held;
+}
+
+static void usage(const char *prog) {
+  fprintf(stderr, "usage: %s [-s rows,cols,k | -u] [-m grid|spsa] [-t ms per move] [-g games per match] [-n spsa steps] [-j threads]\n", prog);
+}
+
+int main(int argc, char **argv) {
+  Tuner t;
+  memset(&t, 0, sizeof(t));
+  t.rows = DEFAULT_ROWS;
+  t.cols = DEFAULT_COLS;
+  t.k = DEFAULT_K;
+  t.moveMs = DEFAULT_MOVE_MS;
+  t.numGames = DEFAULT_GAMES;
+  t.numThreads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+  t.spsaSteps = DEFAULT_SPSA_STEPS;
+  t.mode = TUNE_GRID;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "s:um:t:g:n:j:h")) != -1) {
+    switch (opt) {
+      case 's':
+        if (sscanf(optarg, "%d,%d,%d", &t.rows, &t.cols, &t.k) != 3) {
+          usage(argv[0]);
+          return EXIT_FAILURE;
+        }
+        break;
+      case 'u':
+        t.ultimate = true;
+        break;
+      case 'm':
+        if (strcmp(optarg, "grid") == 0) {
+          t.mode = TUNE_GRID;
+        } else if (strcmp(optarg, "spsa") == 0) {
+          t.mode = TUNE_SPSA;
+        } else {
+          usage(argv[0]);
+          return EXIT_FAILURE;
+        }
+        break;
+      case 't':
+        t.moveMs = atoi(optarg);
+        break;
+      case 'g':
+        t.numGames = atoi(optarg);
+        break;
+      case 'n':
+        t.spsaSteps = atoi(optarg);
+        break;
+      case 'j':
+        t.numThreads = atoi(optarg);
+        break;
+      default:
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+  }
+
+  if (t.ultimate) {
+    t.rows = ULTIMATE_SIZE;
+    t.cols = ULTIMATE_SIZE;
+    t.k = ULTIMATE_DIM;
+  }
+
+  if (t.moveMs < 1 || t.numGames < 2 || t.spsaSteps < 1 || t.numThreads < 1 || !is_valid_board_size(t.rows, t.cols, t.k)) {
+    usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  // a match is over when its games are, not when a move looks settled
+  Game *g = new_tuner_game(&t);
+  get_search_params(g, &t.defaults);
+  t.defaults.earlyStopping = false;
+  t.defaults.solveEmpty = 0;
+  destroy_game(g);
+
+  printf("defaults: ");
+  print_params(&t.defaults);
+  printf("\n");
+
+  struct timespec start, end;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  SearchParams best = t.defaults;
+  if (t.mode == TUNE_GRID) {
+    tune_grid(&t, &best);
+  } else {
+    tune_spsa(&t, &best);
+  }
+
+  printf("best: ");
+  print_params(&best);
+  printf("\n");
+
+  int fastest = find_fastest_time(&t, &best);
+
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  double elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+  printf("fastest: ");
+  print_params(&best);
+  printf(" at %dms/move (tuned in %.1fs)\n", fastest, elapsed);
+
+  return 0;
+}
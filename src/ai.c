@@ -3,30 +3,54 @@
 #include <stdbool.h>
 #include <math.h>
 #include <stdio.h>
+#include <stdint.h>
+#include <limits.h>
 
 #include "ai.h"
-#include "display.h"
-
-Tree *new_tree(Game *gs);
-Node *new_node(Node *parent, Board *src);
-
+#include "alloc.h"
+#include "book.h"
+#include "cache.h"
+#include "latency.h"
+#include "solver.h"
+#include "trace.h"
+
+Tree *new_tree(Game *g, const SearchParams *params);
+static Tree *new_position_tree(Rules *rules, Position *pos, Piece nextTurn, const SearchParams *params);
+static void replant_tree(Tree *t, Position *pos, Piece nextTurn);
+static void play_root_move(Tree *t, int pos);
+Node *new_node(Tree *t, Node *parent, Position *pos, Piece nextTurn);
+
+static void destroy_node(Tree *t, Node *n);
 void destroy_tree(Tree *t);
 
-void copy_board(Board *src, Board *tgt);
-Piece get_next_turn(Board *b);
+static double compute_ucb(Tree *t, Node *n);
 
 static void print_node(Node *n, const char *indent);
 static void print_tree(Tree *t);
 
+// each thread keeps its own generator state so searches can run in parallel
+static _Thread_local unsigned int randSeed = 0;
+
+// read when a tree is created, so set it before any searches start
+static size_t treeMemoryBudget = DEFAULT_TREE_MEMORY;
+static bool earlyStopping = true;
+static FinalSelection finalSelection = FS_ROBUST;
+static double raveEquivalence = RAVE_EQUIVALENCE;
+
+typedef struct NodeBlock {
+  struct NodeBlock *next;
+  Node nodes[NODE_BLOCK_SIZE];
+} NodeBlock;
+
 int random_int(int lower, int upper) {
     // Initialize random seed
-    srand(time(NULL));
+    if (randSeed == 0) randSeed = (unsigned int)time(NULL) ^ (unsigned int)(uintptr_t)&randSeed;
 
     // Calculate range
     int range = upper - lower + 1;
 
     // Generate random integer
-    int random_val = rand() % range;
+    int random_val = rand_r(&randSeed) % range;
 
     // Shift range to desired interval
     return lower + random_val;
@@ -41,8 +65,9 @@ int random_int(int lower, int upper) {
  */
 int next_move(Game *g) {
 
-  for (int i = 0; i < 9; i++) {
-    if (g->board->squares[i]->piece == PIECE_EMPTY) return i;
+  for (int i = 0; i < g->board.numSquares; i++) {
+    if (g->variant == GV_ULTIMATE && !is_ultimate_move_legal(g->ultimate, &g->board, i)) continue;
+    if (g->board.squares[i].piece == PIECE_EMPTY) return i;
   }
 
   return -1;
@@ -51,49 +76,88 @@ int next_move(Game *g) {
 /**
  * @brief The selection phase of MCTS
  * It traverses the tree by selecting child nodes with the highest UCB
- * values until it reaches a node without children and returns
+ * values until it reaches a node without children and returns. The UCB
+ * is worked out here rather than stored, since every sibling's
+ * exploration term grows with the parent's visits
  * 
+ * @param t
  * @param n
  * @return Node* 
  */
-static Node *select_node(Node *n) {
-  if (n->childCount == 0) return n;
-
-  // get child node with highest ucb
-  Node *child;
-  int ucb = 0;
-  for (int i = 0; i < n->childCount; i++) {
-    if (((Node*)n->children[i])->ucb > ucb) {
-      child = (Node*)n->children[i];
-      ucb = child->ucb;
+static Node *select_node(Tree *t, Node *n) {
+  while (n->childCount > 0) {
+    Node *best = NULL;
+    double ucb = -1.;
+
+    for (Node *child = n->firstChild; child != NULL; child = child->nextSibling) {
+      double childUcb = compute_ucb(t, child);
+      if (childUcb > ucb) {
+        best = child;
+        ucb = childUcb;
+      }
     }
+
+    n = best;
   }
 
-  return select_node(child);
+  return n;
+}
+
+static Piece other_piece(Piece p) {
+  return p == PIECE_X ? PIECE_O : PIECE_X;
+}
+
+static bool is_terminal(Tree *t, Node *n) {
+  if (n->winner != PIECE_EMPTY) return true;
+
+  Bitboard moves;
+  get_legal_moves(&t->rules, &n->pos, &moves);
+
+  return bb_is_empty(&moves);
+}
+
+static bool has_room(NodePool *pool, int numNodes) {
+  return pool->maxNodes == 0 || pool->liveNodes + numNodes <= pool->maxNodes;
 }
 
 /**
  * @brief The expansion phase of MCTS
- * Adds child nodes for each possible move
+ * Adds child nodes for each possible move, skipping moves that are
+ * symmetric to one already added. If the tree is at its memory budget
+ * the node is left as a leaf and only gets simulated from
  * 
+ * @param t 
  * @param n 
  */
-static void expand_node(Node *n) {
-  int childInd = 0;
-  int numEmptySquares = num_empty_squares(n->board);
-  n->childCount = numEmptySquares;
-  n->children = calloc(n->childCount, sizeof(void*));
-
-  for (int i = 0; i < 9; i++) {
-    if (n->board->squares[i]->piece == PIECE_EMPTY) {
-      Node *child = new_node(n, n->board);
-      child->board->squares[i]->piece = n->nextTurn;
-      child->movePos = i;
-      child->nextTurn = get_next_turn(child->board);
-      n->children[childInd] = (void*)child;
-      childInd++;
-    }
+static void expand_node(Tree *t, Node *n) {
+  Bitboard moves;
+  get_legal_moves(&t->rules, &n->pos, &moves);
+
+  // mirror images of a move lead to the same position, only search one
+  get_unique_moves(&t->rules, &n->pos, &moves);
+
+  int numMoves = bb_count(&moves);
+  if (numMoves == 0 || !has_room(&t->pool, numMoves)) return;
+
+  Piece mover = n->nextTurn;
+  void **link = &n->firstChild;
+
+  for (int i = 0; i < numMoves; i++) {
+    int bit = bb_first_bit(&moves);
+    bb_unset(&moves, bit);
+
+    Position pos = n->pos;
+    Piece winner = play_move(&t->rules, &pos, bit, mover);
+
+    Node *child = new_node(t, n, &pos, other_piece(mover));
+    child->winner = winner;
+    child->movePos = geom_pos(&t->rules.geom, bit);
+
+    *link = (void*)child;
+    link = &child->nextSibling;
   }
+
+  n->childCount = numMoves;
 }
 
 /**
@@ -101,62 +165,32 @@ static void expand_node(Node *n) {
  * Grabs an immediate win if available
  * Prevents an immediate loss if necessary
  * Returns a random move otherwise
+ * (either of the first two can be turned off in the tree's params)
  * 
- * @param n 
- * @return int 
+ * In ultimate a "win" is completing a line on a sub-board
+ * 
+ * @param t 
+ * @param p 
+ * @param moves the legal moves
+ * @param currentMove 
+ * @return int the bit index of the move
  */
-static int simulate_move(Board *b, Piece currentMove) {
-  int numEmptySquares = num_empty_squares(b);
-  if (numEmptySquares == 0) return -1;
-
-  int winMove = -1;
-  int noLoss = -1;
-  Line wl;
-  Piece winner;
-
-  for (int i = 0; i < 9; i++) {
-    if (b->squares[i]->piece == PIECE_EMPTY) {
-      place_piece(b, i, PIECE_O);
-      wl = get_winning_line(b);
-      winner = get_winning_piece(b, wl);
-
-      if (winner == currentMove) {
-        winMove = i;
-      } else if (winner != PIECE_EMPTY) {
-        noLoss = i;
-      }
-
-      // reset square
-      reset_square(b->squares[i]);
-      
-      place_piece(b, i, PIECE_X);
-      wl = get_winning_line(b);
-      winner = get_winning_piece(b, wl);
-
-      if (winner == currentMove) {
-        winMove = i;
-      } else if (winner != PIECE_EMPTY) {
-        noLoss = i;
-      }
-
-      // reset square
-      reset_square(b->squares[i]);
-    }
+static int simulate_move(Tree *t, Position *p, Bitboard *moves, Piece currentMove) {
+  Bitboard wins;
 
-    if (winMove >= 0) return winMove;
+  if (t->params.grabWins) {
+    get_winning_moves(&t->rules, p, currentMove, moves, &wins);
+    if (!bb_is_empty(&wins)) return bb_first_bit(&wins);
   }
 
-  if (noLoss >= 0) return noLoss;
+  if (t->params.blockLosses) {
+    get_winning_moves(&t->rules, p, other_piece(currentMove), moves, &wins);
+    if (!bb_is_empty(&wins)) return bb_first_bit(&wins);
+  }
 
   // return random move pos
-  int moveNum = random_int(0, (numEmptySquares - 1));
-  int sq = -1;
-  for (int i = 0; i < 9; i++) {
-    if (b->squares[i]->piece == PIECE_EMPTY) sq++;
-    if (sq == moveNum) {
-      return i;
-    }
-  }
+  int moveNum = random_int(0, bb_count(moves) - 1);
+  return bb_nth_bit(moves, moveNum);
 }
 
 /**
@@ -164,180 +198,1186 @@ static int simulate_move(Board *b, Piece currentMove) {
  * Randomly plays the game starting from Node *n until an end condition
  * is reached. 
  * 
+ * @param t 
  * @param n 
- * @return Line 
+ * @param end the position the game ended in, for the RAVE statistics
+ * @return Piece the winner, PIECE_EMPTY for a tie
  */
-static Line simulate_game(Node *n) {
-  // copy the board so we can play the game without messing up the tree
-  Board *b = new_board();
-  copy_board(n->board, b);
+static Piece simulate_game(Tree *t, Node *n, Position *end) {
+  // copy the position so we can play the game without messing up the tree
+  *end = n->pos;
+  Bitboard moves;
+  Piece p = n->nextTurn;
 
-  Line wl = get_winning_line(b);
-  Piece p = get_next_turn(b);
+  get_legal_moves(&t->rules, end, &moves);
 
-  while (wl == NO_WINNER) {
-    int pos = simulate_move(b, p);
-    if (pos < 0) break;
+  while (!bb_is_empty(&moves)) {
+    int bit = simulate_move(t, end, &moves, p);
 
-    if (place_piece(b, pos, p) == BPR_INVALID) {
-      printf("pos: %d | piece: %c\n", pos, get_piece_char(p));
-      print_board(b, "invalid placement");
-      exit(EXIT_FAILURE);
-    }
+    if (play_move(&t->rules, end, bit, p) == p) return p;
 
-    wl = get_winning_line(b);
-    p = get_next_turn(b);
+    p = other_piece(p);
+    get_legal_moves(&t->rules, end, &moves);
   }
 
-  destroy_board(b);
+  return PIECE_EMPTY;
+}
+
+/**
+ * @brief the expected score of the move into n for the player who made
+ * it, counting a draw as half a win
+ * 
+ * @param n 
+ * @return double 
+ */
+static double get_score(Node *n) {
+  if (n->visitCount == 0) return 0.;
+
+  return ((double)n->winCount + (0.5 * n->drawCount)) / (double)n->visitCount;
+}
+
+static double get_amaf_score(Node *n) {
+  if (n->amafVisits == 0) return 0.;
 
-  return wl;
+  return ((double)n->amafWins + (0.5 * n->amafDraws)) / (double)n->amafVisits;
 }
 
-static double compute_ucb(Node *n) {
+/**
+ * @brief the node's score blended with its RAVE score. The RAVE weight
+ * starts at 1 and fades as the node's own visits come in
+ * 
+ * @param t 
+ * @param n 
+ * @return double 
+ */
+static double get_rave_score(Tree *t, Node *n) {
+  if (t->params.raveEquivalence <= 0 || n->amafVisits == 0) return get_score(n);
+
+  double beta = sqrt(t->params.raveEquivalence / ((3. * n->visitCount) + t->params.raveEquivalence));
+
+  return ((1. - beta) * get_score(n)) + (beta * get_amaf_score(n));
+}
+
+/**
+ * @brief the node's UCB as things stand, from its parent's current visits
+ * 
+ * @param t 
+ * @param n 
+ * @return double 
+ */
+static double compute_ucb(Tree *t, Node *n) {
   if (n->parent == NULL) return 0; // ucb of the root node is irrelevant
-  if (n->visitCount == 0) return INITIAL_UCB;
+  // unvisited nodes still all get picked once, best RAVE score first
+  if (n->visitCount == 0) return INITIAL_UCB + get_rave_score(t, n);
   Node *parent = n->parent;
-  return ((double)n->winCount / (double)n->visitCount) + (1.41 * sqrt(log((double)parent->visitCount) / (double)n->visitCount));
+
+  // nodes seeded from the cache can have more visits than their parent,
+  // the +1 keeps their exploration term from being 0 until it catches up
+  return get_rave_score(t, n) + (t->params.exploration * sqrt(log(parent->visitCount + 1.) / (double)n->visitCount));
+}
+
+/**
+ * @brief updates the RAVE statistics of n's children: every child whose
+ * move the side to move at n played somewhere between n and the end of
+ * the game
+ * 
+ * @param t 
+ * @param n 
+ * @param winner 
+ * @param end the position the playout ended in
+ */
+static void update_amaf(Tree *t, Node *n, Piece winner, Position *end) {
+  if (t->params.raveEquivalence <= 0 || n->childCount == 0) return;
+
+  Piece mover = n->nextTurn;
+  Bitboard later;
+  bb_andnot(&later, &end->pieces[mover], &n->pos.pieces[mover]);
+
+  for (Node *child = n->firstChild; child != NULL; child = child->nextSibling) {
+    if (!bb_test(&later, geom_bit(&t->rules.geom, child->movePos))) continue;
+
+    child->amafVisits++;
+    if (winner == mover) {
+      child->amafWins++;
+    } else if (winner == PIECE_EMPTY) {
+      child->amafDraws++;
+    }
+  }
 }
 
-static void backpropagate_node(Node *leaf, bool isWin) {
+/**
+ * @brief Win counts are stored from the perspective of the player who
+ * made the move leading into each node, so the same tree can be searched
+ * on behalf of either side (see ponder)
+ * 
+ * @param t 
+ * @param leaf 
+ * @param winner 
+ * @param end the position the playout ended in
+ */
+static void backpropagate_node(Tree *t, Node *leaf, Piece winner, Position *end) {
   Node *node = leaf;
 
   while (node != NULL) {
     node->visitCount++;
   
-    if (isWin) {
+    // the player who moved into a node is the one not on turn there
+    if (other_piece(node->nextTurn) == winner) {
       node->winCount++;
+    } else if (winner == PIECE_EMPTY) {
+      node->drawCount++;
     }
 
-    node->ucb = compute_ucb(node);
+    update_amaf(t, node, winner, end);
     node = node->parent;
   }
 }
 
-static int choose_best_move(Node *n) {
-  double ucb = 0.;
-  int bestMove = -1;
+static bool is_winning_child(Node *parent, Node *child) {
+  return child->winner != PIECE_EMPTY && child->winner == parent->nextTurn;
+}
+
+/**
+ * @brief picks the move to play: the most visited child, going by score
+ * between children with the same visits. The ucb isn't used, its
+ * exploration bonus would make the choice partly noise
+ * 
+ * @param n 
+ * @return Node* NULL if n has no children
+ */
+static Node *choose_best_child(Node *n) {
+  Node *best = NULL;
+
+  for (Node *child = n->firstChild; child != NULL; child = child->nextSibling) {
+    // a move that wins on the spot needs no statistics
+    if (is_winning_child(n, child)) return child;
+
+    if (best == NULL || child->visitCount > best->visitCount || (child->visitCount == best->visitCount && get_score(child) > get_score(best))) {
+      best = child;
+    }
+  }
+
+  return best;
+}
+
+/**
+ * @brief checks whether the most visited child also has the best score
+ * 
+ * @param n 
+ * @return true if the robust and max child agree
+ */
+static bool is_max_robust(Node *n) {
+  Node *best = choose_best_child(n);
+  if (best == NULL || is_winning_child(n, best)) return true;
+
+  for (Node *child = n->firstChild; child != NULL; child = child->nextSibling) {
+    if (child->visitCount > 0 && get_score(child) > get_score(best)) return false;
+  }
+
+  return true;
+}
+
+/**
+ * @brief a leaf subtree is an expanded node whose children are all
+ * leaves. Collapsing one frees its children and leaves the node as a
+ * leaf that keeps its own statistics
+ * 
+ * @param n 
+ * @return true if n is the top of a leaf subtree
+ */
+static bool is_leaf_subtree(Node *n) {
+  if (n->childCount == 0) return false;
+
+  for (Node *child = n->firstChild; child != NULL; child = child->nextSibling) {
+    if (child->childCount > 0) return false;
+  }
+
+  return true;
+}
+
+static int compare_visits(const void *a, const void *b) {
+  int va = (*(Node* const*)a)->visitCount;
+  int vb = (*(Node* const*)b)->visitCount;
+
+  return va < vb ? -1 : va > vb;
+}
+
+static void collapse_node(Tree *t, Node *n) {
+  Node *child = n->firstChild;
+
+  while (child != NULL) {
+    Node *next = child->nextSibling;
+    t->recycledNodes++;
+    destroy_node(t, child);
+    child = next;
+  }
+
+  n->firstChild = NULL;
+  n->childCount = 0;
+}
+
+/**
+ * @brief makes room in a full tree by collapsing the least visited leaf
+ * subtrees until it's down to RECYCLE_TARGET of its budget. Collapsing
+ * can turn the parent into a leaf subtree, so this repeats until there's
+ * nothing left to collapse below the root
+ * 
+ * @param t 
+ */
+static void recycle_nodes(Tree *t) {
+  uint64_t traceStart = trace_now();
+  NodePool *pool = &t->pool;
+  size_t target = (size_t)(pool->maxNodes * RECYCLE_TARGET);
+  size_t before = pool->liveNodes;
+
+  // sized for a full pool the first time, so a tree that keeps filling
+  // up doesn't allocate each time it's recycled
+  if (pool->scratchSize < pool->liveNodes) {
+    if (pool->scratch != NULL) ttt_free(pool->scratch);
+    pool->bytes -= sizeof(Node*) * 2 * pool->scratchSize;
+    pool->scratchSize = pool->maxNodes > pool->liveNodes ? pool->maxNodes : pool->liveNodes;
+    pool->scratch = ttt_malloc(sizeof(Node*) * 2 * pool->scratchSize);
+    pool->bytes += sizeof(Node*) * 2 * pool->scratchSize;
+  }
+
+  Node **stack = pool->scratch;
+  Node **found = pool->scratch + pool->scratchSize;
+
+  while (pool->liveNodes > target) {
+    size_t top = 0;
+    size_t numFound = 0;
+
+    for (Node *child = t->root->firstChild; child != NULL; child = child->nextSibling) {
+      stack[top++] = child;
+    }
+
+    while (top > 0) {
+      Node *n = stack[--top];
+
+      if (is_leaf_subtree(n)) {
+        found[numFound++] = n;
+        continue;
+      }
+
+      for (Node *child = n->firstChild; child != NULL; child = child->nextSibling) {
+        stack[top++] = child;
+      }
+    }
+
+    if (numFound == 0) break;
+
+    qsort(found, numFound, sizeof(Node*), compare_visits);
+
+    for (size_t i = 0; i < numFound && pool->liveNodes > target; i++) {
+      collapse_node(t, found[i]);
+    }
+  }
+
+  trace_complete("recycle", traceStart, "nodes", (long)(before - pool->liveNodes));
+}
+
+static double get_confidence_radius(Node *n) {
+  return sqrt(log(1. / STOP_DELTA) / (2. * n->visitCount));
+}
+
+/**
+ * @brief decides whether the rest of the search could still change the
+ * move at the root. It can't if there's only one move, if a move wins on
+ * the spot, if the runner-up is too far behind on visits to catch up in
+ * the iterations left, or if the best move's score is confidently
+ * above all of the others
+ * 
+ * @param t 
+ * @param remaining iterations left in the budget
+ * @return true if the search can stop
+ */
+static bool can_stop_search(Tree *t, int remaining) {
+  Node *root = t->root;
+
+  if (root->childCount == 0) return is_terminal(t, root);
+  if (root->childCount == 1) return true;
+
+  Node *best = NULL;
+  Node *second = NULL;
 
-  for (int i = 0; i < n->childCount; i++) {
-    Node *child = (Node*)n->children[i];
-    if (child->ucb > ucb) {
-      ucb = child->ucb;
-      bestMove = child->movePos;
+  for (Node *child = root->firstChild; child != NULL; child = child->nextSibling) {
+    if (is_winning_child(root, child)) return true;
+
+    if (best == NULL || child->visitCount > best->visitCount) {
+      second = best;
+      best = child;
+    } else if (second == NULL || child->visitCount > second->visitCount) {
+      second = child;
     }
   }
 
-  return bestMove;
+  if (best->visitCount - second->visitCount > remaining) return true;
+  if (root->visitCount < STOP_MIN_VISITS || best->visitCount == 0) return false;
+
+  double lower = get_score(best) - get_confidence_radius(best);
+
+  for (Node *child = root->firstChild; child != NULL; child = child->nextSibling) {
+    if (child == best) continue;
+    if (child->visitCount == 0 || get_score(child) + get_confidence_radius(child) >= lower) return false;
+  }
+
+  return true;
 }
 
 /**
  * @brief the main monte carlo tree search loop
  * 
  * @param t 
- * @return int 
+ * @param iterations 
+ * @param canStop whether to stop early once the move is settled
+ * @param deadline when to stop, NULL for no deadline
+ * @return int the number of iterations run
  */
-static int mcts(Tree *t) {
+static int mcts(Tree *t, int iterations, bool canStop, const Deadline *deadline) {
+  uint64_t traceStart = trace_now();
+  int maxChildren = t->rules.geom.numSquares;
+  bool canRecycle = true;
+  int run = iterations;
 
-  while (t->iterCount <= MAX_ITERATIONS) {
+  for (int i = 0; i < iterations; i++) {
     Node *n;
+
+    // recycle between iterations, when no node is in use. If it can't
+    // make enough room, the rest of this search only simulates
+    if (canRecycle && !has_room(&t->pool, maxChildren)) {
+      recycle_nodes(t);
+      canRecycle = has_room(&t->pool, maxChildren);
+    }
     
-    n = select_node(t->root);
+    TRACE_PROBE1(select, t->iterCount);
+    n = select_node(t, t->root);
 
-    Line wl = get_winning_line(n->board);
+    Piece winner = n->winner;
+    Position end = n->pos;
 
-    if (wl == NO_WINNER) {
-      expand_node(n);
-      wl = simulate_game(n);
+    if (!is_terminal(t, n)) {
+      TRACE_PROBE(expand);
+      expand_node(t, n);
+      TRACE_PROBE(simulate);
+      winner = simulate_game(t, n, &end);
     }
 
-    Piece winner = get_winning_piece(n->board, wl);
-    
-    if (winner == t->player) {
-      backpropagate_node(n, true);
-    } else {
-      backpropagate_node(n, false);
-    }
+    TRACE_PROBE(backpropagate);
+    backpropagate_node(t, n, winner, &end);
     
     t->iterCount++;
+
+    if (i % STOP_CHECK_INTERVAL == 0) {
+      bool stop = (canStop && can_stop_search(t, iterations - i - 1)) || is_past_deadline(deadline);
+      if (stop) {
+        run = i + 1;
+        break;
+      }
+    }
   }
 
-  return choose_best_move(t->root);
+  trace_complete("iterations", traceStart, "count", run);
+
+  return run;
 }
 
-int get_next_move(Game *g) {
-  Tree *t = new_tree(g);
+static bool is_same_params(const SearchParams *a, const SearchParams *b) {
+  return a->exploration == b->exploration && a->raveEquivalence == b->raveEquivalence && a->grabWins == b->grabWins && a->blockLosses == b->blockLosses && a->earlyStopping == b->earlyStopping && a->finalSelection == b->finalSelection && a->solveEmpty == b->solveEmpty;
+}
+
+static bool is_same_game_type(Tree *t, Game *g) {
+  Geometry *geom = &t->rules.geom;
+  Board *b = &g->board;
+
+  return t->rules.variant == g->variant && geom->rows == b->rows && geom->cols == b->cols && geom->k == b->k;
+}
+
+/**
+ * @brief maps every position and move of a subtree through a symmetry of
+ * the board
+ * 
+ * @param t 
+ * @param n 
+ * @param sym 
+ */
+static void transform_subtree(Tree *t, Node *n, int sym) {
+  Geometry *geom = &t->rules.geom;
+
+  transform_position(&t->rules, sym, &n->pos, &n->pos);
+  if (n->movePos >= 0) {
+    n->movePos = geom_pos(geom, transform_bit(&t->rules, sym, geom_bit(geom, n->movePos)));
+  }
+
+  for (Node *child = n->firstChild; child != NULL; child = child->nextSibling) {
+    transform_subtree(t, child, sym);
+  }
+}
+
+static Node *take_child(Node *n, int pos) {
+  for (void **link = &n->firstChild; *link != NULL; link = &((Node*)*link)->nextSibling) {
+    Node *child = (Node*)*link;
+    if (child->movePos == pos) {
+      *link = child->nextSibling;
+      child->nextSibling = NULL;
+      n->childCount--;
+      return child;
+    }
+  }
+
+  return NULL;
+}
+
+/**
+ * @brief re-roots the tree at the child reached by playing pos, keeping
+ * all of the statistics gathered for that subtree and freeing the rest.
+ * If pos was pruned as a mirror image of another move, that move's
+ * subtree is mapped back onto the real board and promoted instead
+ * 
+ * @param t 
+ * @param pos 
+ * @return true if the child had already been expanded
+ */
+static bool promote_child(Tree *t, int pos) {
+  Node *root = t->root;
+  Node *promoted = take_child(root, pos);
+
+  if (promoted == NULL && root->childCount > 0) {
+    Geometry *geom = &t->rules.geom;
+    int syms[MAX_SYMMETRIES];
+    int numSyms = get_stabilizer(&t->rules, &root->pos, syms);
+
+    for (int i = 1; i < numSyms && promoted == NULL; i++) {
+      int image = geom_pos(geom, transform_bit(&t->rules, syms[i], geom_bit(geom, pos)));
+      promoted = take_child(root, image);
+      if (promoted != NULL) transform_subtree(t, promoted, inverse_symmetry(syms[i]));
+    }
+  }
+
+  if (promoted == NULL) return false;
+
+  destroy_node(t, root);
+
+  trace_instant("reroot", "visits", promoted->visitCount);
+
+  promoted->parent = NULL;
+  promoted->movePos = -1;
+  t->root = promoted;
+  t->player = promoted->nextTurn;
+  t->iterCount = 0;
+  t->solveFailed = false;
+
+  return true;
+}
+
+/**
+ * @brief finds the single move that takes node n to position p
+ * 
+ * @param n 
+ * @param p 
+ * @return int the move's bit, or -1 if p isn't one move below n
+ */
+static int get_move_between(Node *n, Position *p) {
+  Piece mover = n->nextTurn;
+  Bitboard added, removed;
+
+  if (!bb_equal(&n->pos.pieces[other_piece(mover)], &p->pieces[other_piece(mover)])) return -1;
+
+  bb_andnot(&added, &p->pieces[mover], &n->pos.pieces[mover]);
+  bb_andnot(&removed, &n->pos.pieces[mover], &p->pieces[mover]);
+  if (!bb_is_empty(&removed) || bb_count(&added) != 1) return -1;
+
+  return bb_first_bit(&added);
+}
+
+/**
+ * @brief returns the game's search tree, re-rooted at the current board.
+ * The existing tree is kept if the board is still its root or is one
+ * move below it, otherwise it's replanted at the board, reusing its
+ * pool. A tree built with other params or for another game is thrown
+ * away
+ * 
+ * @param g 
+ * @param params 
+ * @return Tree* 
+ */
+static Tree *get_search_tree(Game *g, const SearchParams *params) {
+  Tree *t = (Tree*)g->tree;
+
+  if (t != NULL && (!is_same_game_type(t, g) || !is_same_params(&t->params, params))) {
+    destroy_tree(t);
+    t = NULL;
+  }
+
+  if (t != NULL) {
+    Position pos;
+    game_to_position(&t->rules, g, &pos);
+
+    if (is_same_position(&t->root->pos, &pos)) return t;
+
+    int bit = get_move_between(t->root, &pos);
+    if (bit >= 0 && promote_child(t, geom_pos(&t->rules.geom, bit))) return t;
+
+    replant_tree(t, &pos, get_next_turn(&g->board));
+    return t;
+  }
+
+  t = new_tree(g, params);
+  g->tree = (void*)t;
+
+  return t;
+}
+
+/**
+ * @brief fills in the outcome rates of the chosen move. A move that wins
+ * on the spot is a sure win however few visits it has
+ * 
+ * @param parent 
+ * @param best 
+ * @param stats 
+ */
+static void get_outcome_rates(Node *parent, Node *best, SearchStats *stats) {
+  if (best != NULL && is_winning_child(parent, best)) {
+    stats->win = 1.;
+    stats->draw = 0.;
+    stats->loss = 0.;
+  } else if (best == NULL || best->visitCount == 0) {
+    stats->win = 0.;
+    stats->draw = 0.;
+    stats->loss = 0.;
+  } else {
+    stats->win = (double)best->winCount / (double)best->visitCount;
+    stats->draw = (double)best->drawCount / (double)best->visitCount;
+    stats->loss = 1. - stats->win - stats->draw;
+  }
+
+  stats->value = stats->win + (0.5 * stats->draw);
+}
+
+/**
+ * @brief the squares that could still be played in the game, which in
+ * ultimate leaves out the empty squares of closed sub-boards
+ * 
+ * @param t 
+ * @param p 
+ * @return int 
+ */
+static int count_open_squares(Tree *t, Position *p) {
+  Rules *r = &t->rules;
+  Bitboard occupied;
+  bb_or(&occupied, &p->pieces[PIECE_X], &p->pieces[PIECE_O]);
+
+  if (r->variant != GV_ULTIMATE) return r->geom.numSquares - bb_count(&occupied);
+
+  int count = 0;
+  for (int sub = 0; sub < ULTIMATE_SIZE; sub++) {
+    if (p->subClosed & (1 << sub)) continue;
+
+    Bitboard open;
+    bb_andnot(&open, &r->subSquares[sub], &occupied);
+    count += bb_count(&open);
+  }
+
+  return count;
+}
+
+/**
+ * @brief tries to solve the root exactly, if it's close enough to the end
+ * of the game. There's no point spending playouts on a subtree small
+ * enough to see all of. A root the solver gave up on isn't tried again
+ * 
+ * @param t 
+ * @param iterations the budget the search would have had
+ * @param deadline the solver gives up when it passes, NULL for none
+ * @param stats optional, may be NULL
+ * @return int the best square, -1 if the root wasn't solved
+ */
+static int solve_root(Tree *t, int iterations, const Deadline *deadline, SearchStats *stats) {
+  SolverResult result = { .nodes = 0 };
+
+  if (t->params.solveEmpty <= 0 || t->solveFailed) return -1;
+  if (count_open_squares(t, &t->root->pos) > t->params.solveEmpty) return -1;
+  if (is_past_deadline(deadline)) return -1;
+
+  uint64_t traceStart = trace_now();
+  bool solved = solve_position(&t->rules, &t->root->pos, t->root->nextTurn, SOLVER_MAX_NODES, deadline, &result);
+  trace_complete("solve", traceStart, "nodes", result.nodes);
+
+  if (!solved) {
+    t->solveFailed = true;
+    return -1;
+  }
+
+  if (stats != NULL) {
+    stats->move = result.move;
+    stats->iterations = 0;
+    stats->savedIterations = !has_deadline(deadline) ? iterations : 0;
+    stats->rootVisits = t->root->visitCount;
+    stats->moveVisits = 0;
+    stats->win = result.value > 0 ? 1. : 0.;
+    stats->draw = result.value == 0 ? 1. : 0.;
+    stats->loss = result.value < 0 ? 1. : 0.;
+    stats->value = stats->win + (0.5 * stats->draw);
+    stats->solved = true;
+    stats->treeBytes = t->pool.bytes;
+    stats->recycledNodes = t->recycledNodes;
+  }
+
+  return result.move;
+}
+
+/**
+ * @brief picks the tree's move as things stand and reports it
+ * 
+ * @param t 
+ * @param run iterations to report as run
+ * @param saved iterations to report as saved
+ * @param stats optional, may be NULL
+ * @return int the chosen square, or -1 if there are no moves
+ */
+static int get_tree_move(Tree *t, int run, int saved, SearchStats *stats) {
+  Node *best = choose_best_child(t->root);
+  int pos = best == NULL ? -1 : best->movePos;
+
+  if (stats != NULL) {
+    stats->move = pos;
+    stats->iterations = run;
+    stats->savedIterations = saved;
+    stats->rootVisits = t->root->visitCount;
+    stats->moveVisits = best == NULL ? 0 : best->visitCount;
+    get_outcome_rates(t->root, best, stats);
+    stats->solved = false;
+    stats->treeBytes = t->pool.bytes;
+    stats->recycledNodes = t->recycledNodes;
+  }
+
+  return pos;
+}
+
+/**
+ * @brief searches the game's current position for the given number of
+ * iterations and reports the chosen move along with its statistics
+ * 
+ * @param g 
+ * @param iterations 
+ * @param stats optional, may be NULL
+ * @return int the chosen square, or -1 if there are no moves
+ */
+int search_position(Game *g, int iterations, SearchStats *stats) {
+  SearchParams params;
+  get_search_params(g, &params);
+
+  return search_position_with(g, &params, iterations, 0, stats);
+}
+
+/**
+ * @brief searches the game's current position with the given params,
+ * until it has run the given number of iterations or passed the
+ * deadline, whichever comes first
+ * 
+ * @param g 
+ * @param params 
+ * @param iterations 
+ * @param deadline 
+ * @param stats optional, may be NULL
+ * @return int the chosen square, or -1 if there are no moves
+ */
+static int search_position_by(Game *g, const SearchParams *params, int iterations, const Deadline *deadline, SearchStats *stats) {
+  uint64_t traceStart = trace_now();
+  Tree *t = get_search_tree(g, params);
+
+  TRACE_PROBE1(search_start, iterations);
+
+  int solved = solve_root(t, iterations, deadline, stats);
+  if (solved >= 0) {
+    trace_complete("search", traceStart, "iterations", 0);
+    return solved;
+  }
 
   // printf("turn: %c\n", get_piece_char(t->player));
 
-  int pos = mcts(t);
+  int run = mcts(t, iterations, params->earlyStopping, deadline);
+
+  // an early stop means the move is settled, otherwise search on a bit
+  // if the most visited move isn't the best scoring one
+  if (params->finalSelection == FS_MAX_ROBUST && run == iterations) {
+    int extra = 0;
+
+    while (extra < iterations / MAX_ROBUST_EXTRA && !is_max_robust(t->root)) {
+      extra += mcts(t, MAX_ROBUST_BATCH, false, NULL);
+    }
+
+    run += extra;
+  }
 
   // print_tree(t);
 
-  destroy_tree(t);
+  TRACE_PROBE1(search_end, run);
+  trace_complete("search", traceStart, "iterations", run);
 
-  return pos;
+  return get_tree_move(t, run, run < iterations && !has_deadline(deadline) ? iterations - run : 0, stats);
+}
+
+/**
+ * @brief searches the game's current position with the given params,
+ * until it has run the given number of iterations or used cpuMs of the
+ * calling thread's CPU time, whichever comes first
+ * 
+ * @param g 
+ * @param params 
+ * @param iterations 
+ * @param cpuMs 0 for no time limit
+ * @param stats optional, may be NULL
+ * @return int the chosen square, or -1 if there are no moves
+ */
+int search_position_with(Game *g, const SearchParams *params, int iterations, int cpuMs, SearchStats *stats) {
+  Deadline deadline;
+  set_deadline(&deadline, CLOCK_THREAD_CPUTIME_ID, cpuMs);
+
+  return search_position_by(g, params, iterations, &deadline, stats);
+}
+
+/**
+ * @brief picks the CPU's move: straight from the opening book if the
+ * position is in it, otherwise by searching
+ * 
+ * @param g 
+ * @return int 
+ */
+int get_next_move(Game *g) {
+  return get_next_move_within(g, 0);
+}
+
+/**
+ * @brief get_next_move on a wall clock budget: with one, the search runs
+ * until ms have passed (or the move is solved) instead of for the usual
+ * number of iterations
+ * 
+ * @param g 
+ * @param ms 0 for no budget
+ * @return int 
+ */
+int get_next_move_within(Game *g, int ms) {
+  int pos = probe_opening_book(g);
+  if (pos >= 0) return pos;
+
+  SearchParams params;
+  Deadline deadline;
+  get_search_params(g, &params);
+  set_deadline(&deadline, CLOCK_MONOTONIC, ms);
+
+  int iterations = g->variant == GV_ULTIMATE ? ULTIMATE_ITERATIONS : MAX_ITERATIONS;
+
+  return search_position_by(g, &params, has_deadline(&deadline) ? INT_MAX : iterations, &deadline, NULL);
+}
+
+/**
+ * @brief runs a batch of search iterations on the opponent's time. Meant
+ * to be called repeatedly while waiting on the player's input
+ * 
+ * @param g 
+ * @return true if there is still pondering left to do
+ */
+bool ponder(Game *g) {
+  if (g->state != GS_PLAYER_TURN) return false;
+
+  SearchParams params;
+  get_search_params(g, &params);
+
+  Tree *t = get_search_tree(g, &params);
+  if (t->iterCount >= PONDER_MAX_ITERATIONS) return false;
+
+  // pondering has no move to settle, it just builds up the tree
+  mcts(t, PONDER_BATCH, false, NULL);
+
+  return true;
+}
+
+/**
+ * @brief informs the search tree that pos was played on the game's board
+ * so the matching subtree can be promoted to the root. If there's none
+ * the tree is left alone, the next search replants it at the board
+ * 
+ * @param g 
+ * @param pos 
+ */
+void advance_search_tree(Game *g, int pos) {
+  Tree *t = (Tree*)g->tree;
+  if (t == NULL) return;
+
+  promote_child(t, pos);
+}
+
+void destroy_search_tree(Game *g) {
+  if (g->tree == NULL) return;
+
+  destroy_tree((Tree*)g->tree);
+  g->tree = NULL;
+}
+
+/**
+ * @brief caps the memory each search tree created from now on may use
+ * for its nodes and the lists that recycle them. A tree that reaches
+ * the cap recycles its least visited subtrees, and only simulates from
+ * its leaves if that isn't enough
+ * 
+ * @param bytes 0 for no limit
+ */
+void set_tree_memory_budget(size_t bytes) {
+  treeMemoryBudget = bytes;
+}
+
+/**
+ * @brief turns early stopping of searches on or off. It's on by default;
+ * turning it off makes every search run its full number of iterations
+ * 
+ * @param enabled 
+ */
+void set_early_stopping(bool enabled) {
+  earlyStopping = enabled;
+}
+
+void set_final_selection(FinalSelection selection) {
+  finalSelection = selection;
+}
+
+/**
+ * @brief sets how many visits of its own a node needs before its RAVE
+ * statistics stop counting for much, for trees created from now on on
+ * boards of at least RAVE_MIN_SQUARES squares
+ * 
+ * @param equivalence 0 to turn RAVE off
+ */
+void set_rave_equivalence(double equivalence) {
+  raveEquivalence = equivalence;
+}
+
+/**
+ * @brief the params search_position uses for the game's board type,
+ * including anything changed with the set_ functions above
+ * 
+ * @param g 
+ * @param params 
+ */
+void get_search_params(Game *g, SearchParams *params) {
+  params->exploration = g->variant == GV_ULTIMATE ? ULTIMATE_EXPLORATION : UCB_EXPLORATION;
+  params->raveEquivalence = g->variant == GV_STANDARD && g->board.numSquares >= RAVE_MIN_SQUARES ? raveEquivalence : 0;
+  params->grabWins = true;
+  params->blockLosses = true;
+  params->earlyStopping = earlyStopping;
+  params->finalSelection = finalSelection;
+  // a board the solver could finish from the first move is left to the
+  // search, callers can still set solveEmpty to solve it
+  params->solveEmpty = g->board.numSquares > SOLVER_MAX_EMPTY ? SOLVER_MAX_EMPTY : 0;
+}
+
+/**
+ * @brief creates a search handle for the game's current position. The
+ * handle has its own tree, it doesn't touch the game or the game's tree
+ * 
+ * @param g 
+ * @param params NULL for the defaults for the game's board
+ * @return Search* 
+ */
+Search *new_search(Game *g, const SearchParams *params) {
+  SearchParams defaults;
+  if (params == NULL) {
+    get_search_params(g, &defaults);
+    params = &defaults;
+  }
+
+  Search *s = ttt_malloc(sizeof(Search));
+  s->tree = new_tree(g, params);
+  s->solveTried = false;
+  s->solved = false;
+
+  return s;
+}
+
+/**
+ * @brief runs up to the given number of iterations and returns. The
+ * first step from a new root tries the exact solver, and once the root
+ * is solved there's nothing left to run
+ * 
+ * @param s 
+ * @param iterations 
+ * @return int the number of iterations run
+ */
+int step_search(Search *s, int iterations) {
+  if (!s->solveTried) {
+    s->solveTried = true;
+    s->solved = solve_root(s->tree, 0, NULL, &s->solution) >= 0;
+  }
+
+  if (s->solved || iterations <= 0) return 0;
+
+  return mcts(s->tree, iterations, false, NULL);
+}
+
+/**
+ * @brief checks whether more searching could still change the move.
+ * Never true before the root is solved if early stopping is off
+ * 
+ * @param s 
+ * @param remaining iterations the caller still means to run
+ * @return true if the move is settled
+ */
+bool is_search_settled(Search *s, int remaining) {
+  return s->solved || (s->tree->params.earlyStopping && can_stop_search(s->tree, remaining));
 }
 
-Tree *new_tree(Game *g) {
-  Tree *t = malloc(sizeof(Tree));
+/**
+ * @brief the best move found so far, with its statistics. Can be asked
+ * for between any two steps
+ * 
+ * @param s 
+ * @param stats optional, may be NULL
+ * @return int the chosen square, or -1 if there's no move yet
+ */
+int get_search_move(Search *s, SearchStats *stats) {
+  if (s->solved) {
+    if (stats != NULL) *stats = s->solution;
+    return s->solution.move;
+  }
+
+  return get_tree_move(s->tree, s->tree->iterCount, 0, stats);
+}
+
+/**
+ * @brief plays pos at the root and re-roots the tree on the new
+ * position, keeping the subtree already searched for it
+ * 
+ * @param s 
+ * @param pos 
+ * @return true if pos was legal, the handle is unchanged otherwise
+ */
+bool apply_search_move(Search *s, int pos) {
+  Tree *t = s->tree;
+  Geometry *geom = &t->rules.geom;
+
+  if (pos < 0 || pos >= geom->numSquares || t->root->winner != PIECE_EMPTY) return false;
+
+  int bit = geom_bit(geom, pos);
+  Bitboard legal;
+  get_legal_moves(&t->rules, &t->root->pos, &legal);
+  if (!bb_test(&legal, bit)) return false;
+
+  play_root_move(t, pos);
+
+  s->solveTried = false;
+  s->solved = false;
+
+  return true;
+}
 
-  Node *root = new_node(NULL, g->board);
+void destroy_search(Search *s) {
+  destroy_tree(s->tree);
+  ttt_free(s);
+}
+
+Tree *new_tree(Game *g, const SearchParams *params) {
+  Rules rules;
+  init_rules(&rules, g->variant, g->board.rows, g->board.cols, g->board.k);
+
+  Position pos;
+  game_to_position(&rules, g, &pos);
+
+  return new_position_tree(&rules, &pos, get_next_turn(&g->board), params);
+}
+
+static Tree *new_position_tree(Rules *rules, Position *pos, Piece nextTurn, const SearchParams *params) {
+  Tree *t = ttt_malloc(sizeof(Tree));
+  t->rules = *rules;
+  t->params = *params;
+
+  t->pool.blocks = NULL;
+  t->pool.blockUsed = 0;
+  t->pool.freeList = NULL;
+  t->pool.liveNodes = 0;
+  // each node may also need a place in both of recycling's work lists
+  t->pool.maxNodes = treeMemoryBudget / (sizeof(Node) + (2 * sizeof(Node*)));
+  t->pool.bytes = 0;
+  t->pool.scratch = NULL;
+  t->pool.scratchSize = 0;
+  t->recycledNodes = 0;
+
+  // a budget too small for one node would mean no limit at all
+  if (treeMemoryBudget > 0 && t->pool.maxNodes == 0) t->pool.maxNodes = 1;
+
+  t->root = NULL;
+  replant_tree(t, pos, nextTurn);
+
+  return t;
+}
+
+/**
+ * @brief throws the tree's nodes back into its pool and starts over from
+ * a new root. The pool's blocks are kept, so a tree that's been used
+ * before can start again without allocating
+ * 
+ * @param t 
+ * @param pos 
+ * @param nextTurn 
+ */
+static void replant_tree(Tree *t, Position *pos, Piece nextTurn) {
+  if (t->root != NULL) {
+    trace_instant("replant", "visits", t->root->visitCount);
+    destroy_node(t, t->root);
+  }
+
+  Node *root = new_node(t, NULL, pos, nextTurn);
   t->root = root;
 
+  // the root could already be decided
+  root->winner = get_position_winner(&t->rules, pos);
+
   t->iterCount = 0;
-  
-  if (g->state == GS_CPU_TURN) {
-    t->player = PIECE_O;
-  } else if (g->state == GS_PLAYER_TURN) {
-    t->player = PIECE_X;
+  t->player = root->nextTurn;
+  t->solveFailed = false;
+}
+
+/**
+ * @brief moves the root down the move at pos, keeping its subtree if it
+ * was searched and replanting the tree at the new position if not
+ * 
+ * @param t 
+ * @param pos must be legal at the root
+ */
+static void play_root_move(Tree *t, int pos) {
+  if (promote_child(t, pos)) return;
+
+  Position next = t->root->pos;
+  Piece turn = t->root->nextTurn;
+  play_move(&t->rules, &next, geom_bit(&t->rules.geom, pos), turn);
+
+  replant_tree(t, &next, other_piece(turn));
+}
+
+static Node *alloc_node(NodePool *pool) {
+  Node *n = pool->freeList;
+
+  if (n != NULL) {
+    pool->freeList = n->nextSibling;
+  } else {
+    NodeBlock *block = (NodeBlock*)pool->blocks;
+
+    if (block == NULL || pool->blockUsed == NODE_BLOCK_SIZE) {
+      block = ttt_malloc(sizeof(NodeBlock));
+      block->next = (NodeBlock*)pool->blocks;
+      pool->blocks = (void*)block;
+      pool->blockUsed = 0;
+      pool->bytes += sizeof(NodeBlock);
+    }
+
+    n = &block->nodes[pool->blockUsed++];
   }
 
-  return t;
+  pool->liveNodes++;
+
+  return n;
 }
 
-Node *new_node(Node *parent, Board *src) {
-  Node *n = malloc(sizeof(Node));
+static void free_node(NodePool *pool, Node *n) {
+  n->nextSibling = pool->freeList;
+  pool->freeList = n;
+  pool->liveNodes--;
+}
+
+/**
+ * @brief creates a node for pos. If the statistics cache is open the
+ * node starts out with what earlier searches learned about the position,
+ * scaled down to at most CACHE_MAX_PRIOR visits
+ * 
+ * @param t 
+ * @param parent 
+ * @param pos 
+ * @param nextTurn 
+ * @return Node* 
+ */
+Node *new_node(Tree *t, Node *parent, Position *pos, Piece nextTurn) {
+  Node *n = alloc_node(&t->pool);
   n->parent = parent;
   n->childCount = 0;
-  n->children = NULL;
-  n->board = new_board();
-  copy_board(src, n->board);
-  n->nextTurn = get_next_turn(n->board);
+  n->firstChild = NULL;
+  n->nextSibling = NULL;
+  n->pos = *pos;
+  n->nextTurn = nextTurn;
+  n->winner = PIECE_EMPTY;
   n->movePos = -1;
   n->visitCount = 0;
   n->winCount = 0;
-  n->ucb = INITIAL_UCB;
+  n->drawCount = 0;
+  n->amafVisits = 0;
+  n->amafWins = 0;
+  n->amafDraws = 0;
+  n->cacheKey = 0;
+  n->priorVisits = 0;
+  n->priorWins = 0;
+  n->priorDraws = 0;
+
+  if (!is_stats_cache_open()) return n;
+
+  int visits, wins, draws;
+  n->cacheKey = get_canonical_key(&t->rules, pos, NULL);
+
+  if (lookup_cached_stats(n->cacheKey, &visits, &wins, &draws)) {
+    if (wins > visits) wins = visits;
+    if (draws > visits - wins) draws = visits - wins;
+    if (visits > CACHE_MAX_PRIOR) {
+      wins = (int)((double)wins * CACHE_MAX_PRIOR / visits);
+      draws = (int)((double)draws * CACHE_MAX_PRIOR / visits);
+      visits = CACHE_MAX_PRIOR;
+    }
+
+    n->visitCount = n->priorVisits = visits;
+    n->winCount = n->priorWins = wins;
+    n->drawCount = n->priorDraws = draws;
+  }
 
   return n;
 }
 
-static void destroy_node(Node *n) {
-  for (int i = 0; i < n->childCount; i++) {
-    destroy_node(n->children[i]);
+/**
+ * @brief returns a subtree to the pool, first adding what was learned in
+ * it to the statistics cache. Seeded priors are taken back out so they
+ * aren't counted twice
+ * 
+ * @param t 
+ * @param n 
+ */
+static void destroy_node(Tree *t, Node *n) {
+  Node *child = n->firstChild;
+
+  while (child != NULL) {
+    Node *next = child->nextSibling;
+    destroy_node(t, child);
+    child = next;
   }
 
-  destroy_board(n->board);
-  free(n->children);
-  free(n);
+  if (n->cacheKey != 0) add_cached_stats(n->cacheKey, n->visitCount - n->priorVisits, n->winCount - n->priorWins, n->drawCount - n->priorDraws);
+
+  free_node(&t->pool, n);
 }
 
 void destroy_tree(Tree *t) {
-  destroy_node(t->root);
-  free(t);
-}
+  destroy_node(t, t->root);
 
-void copy_board(Board *src, Board *tgt) {
-  for (int i = 0; i < 9; i++) {
-    tgt->squares[i]->piece = src->squares[i]->piece;
+  NodeBlock *block = (NodeBlock*)t->pool.blocks;
+  while (block != NULL) {
+    NodeBlock *next = block->next;
+    ttt_free(block);
+    block = next;
   }
+
+  if (t->pool.scratch != NULL) ttt_free(t->pool.scratch);
+
+  ttt_free(t);
 }
 
 static void print_node(Node *n, const char *indent) {
   printf("%s pos:      %d\n", indent, n->movePos);
   printf("%s children: %d\n", indent, n->childCount);
-  printf("%s ucb:      %lf\n", indent, n->ucb);
   printf("%s wins:     %d\n", indent, n->winCount);
+  printf("%s draws:    %d\n", indent, n->drawCount);
   printf("%s visits:   %d\n", indent, n->visitCount);
 }
 
@@ -348,8 +1388,95 @@ static void print_tree(Tree *t) {
   printf("== children: %d\n", t->root->childCount);
   printf("----\n");
 
-  for (int i = 0; i < t->root->childCount; i++) {
-    print_node(t->root->children[i], "====");
+  for (Node *child = t->root->firstChild; child != NULL; child = child->nextSibling) {
+    print_node(child, "====");
     printf("----\n");
   }
-}
\ No newline at end of file
+}
+
+typedef struct TreeExport {
+  Tree *tree;
+  FILE *out;
+  TreeFormat format;
+  int maxDepth;
+  int minVisits;
+  long nextId;
+} TreeExport;
+
+static void export_dot_node(TreeExport *e, Node *n, long id, long parentId) {
+  if (parentId < 0) {
+    fprintf(e->out, "  n%ld [label=\"root\\n%c to move\\n%d visits\"];\n", id, get_piece_char(n->nextTurn), n->visitCount);
+    return;
+  }
+
+  fprintf(e->out, "  n%ld [label=\"%d visits\\n%.3f", id, n->visitCount, n->visitCount > 0 ? get_score(n) : 0.);
+  if (n->winner != PIECE_EMPTY) fprintf(e->out, "\\n%c wins", get_piece_char(n->winner));
+  fprintf(e->out, "\"%s];\n", n->winner != PIECE_EMPTY ? ", style=bold" : "");
+
+  fprintf(e->out, "  n%ld -> n%ld [label=\"%d\"];\n", parentId, id, n->movePos);
+}
+
+static void export_json_node(TreeExport *e, Node *n, long id, long parentId, int depth) {
+  fprintf(e->out, "{\"id\":%ld,\"parent\":%ld,\"depth\":%d,\"move\":%d,\"toMove\":\"%c\",\"visits\":%d,\"wins\":%d,\"draws\":%d",
+    id, parentId, depth, n->movePos, get_piece_char(n->nextTurn), n->visitCount, n->winCount, n->drawCount);
+  fprintf(e->out, ",\"amafVisits\":%d,\"amafWins\":%d,\"priorVisits\":%d,\"children\":%d", n->amafVisits, n->amafWins, n->priorVisits, n->childCount);
+
+  // an unvisited node's ucb is just INITIAL_UCB
+  if (n->visitCount > 0) fprintf(e->out, ",\"value\":%.4f,\"ucb\":%.4f", get_score(n), compute_ucb(e->tree, n));
+  if (n->winner != PIECE_EMPTY) fprintf(e->out, ",\"winner\":\"%c\"", get_piece_char(n->winner));
+
+  fprintf(e->out, "}\n");
+}
+
+/**
+ * @brief writes a node and then, depth first, every child that passes
+ * the depth and visit thresholds. Nothing is gathered up beforehand,
+ * each node is written as the walk reaches it
+ * 
+ * @param e 
+ * @param n 
+ * @param parentId -1 for the root
+ * @param depth 
+ */
+static void export_node(TreeExport *e, Node *n, long parentId, int depth) {
+  long id = e->nextId++;
+
+  if (e->format == TF_DOT) {
+    export_dot_node(e, n, id, parentId);
+  } else {
+    export_json_node(e, n, id, parentId, depth);
+  }
+
+  if (e->maxDepth >= 0 && depth >= e->maxDepth) return;
+
+  for (Node *child = n->firstChild; child != NULL; child = child->nextSibling) {
+    if (child->visitCount < e->minVisits) continue;
+    export_node(e, child, id, depth + 1);
+  }
+}
+
+/**
+ * @brief streams the search tree out to out, see TreeFormat. Subtrees
+ * whose root has fewer than minVisits visits are left out
+ * 
+ * @param t 
+ * @param out 
+ * @param format 
+ * @param maxDepth deepest level to write, the root is 0. -1 for all
+ * @param minVisits 
+ * @return long the number of nodes written
+ */
+long export_search_tree(Tree *t, FILE *out, TreeFormat format, int maxDepth, int minVisits) {
+  TreeExport e = { t, out, format, maxDepth, minVisits, 0 };
+
+  if (format == TF_DOT) {
+    fprintf(out, "digraph tree {\n");
+    fprintf(out, "  node [shape=box, fontname=monospace];\n");
+  }
+
+  export_node(&e, t->root, -1, 0);
+
+  if (format == TF_DOT) fprintf(out, "}\n");
+
+  return e.nextId;
+}
@@ -0,0 +1,26 @@
+#include <stdlib.h>
+
+#include "alloc.h"
+
+static AllocHook allocHook = malloc;
+static FreeHook freeHook = free;
+
+/**
+ * @brief routes libttt's allocations through alloc and release. NULL
+ * puts back malloc or free
+ * 
+ * @param alloc 
+ * @param release 
+ */
+void set_alloc_hooks(AllocHook alloc, FreeHook release) {
+  allocHook = alloc == NULL ? malloc : alloc;
+  freeHook = release == NULL ? free : release;
+}
+
+void *ttt_malloc(size_t size) {
+  return allocHook(size);
+}
+
+void ttt_free(void *ptr) {
+  freeHook(ptr);
+}
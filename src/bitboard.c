@@ -0,0 +1,230 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "bitboard.h"
+
+/**
+ * @brief sets up the bit layout for a rows x cols board where k in a
+ * row wins
+ *
+ * @param geom
+ * @param rows
+ * @param cols
+ * @param k
+ */
+void init_geometry(Geometry *geom, int rows, int cols, int k) {
+  geom->rows = rows;
+  geom->cols = cols;
+  geom->k = k;
+  geom->stride = cols + 1;
+  geom->numSquares = rows * cols;
+
+  geom->shifts[LD_ROW] = 1;
+  geom->shifts[LD_COL] = geom->stride;
+  geom->shifts[LD_BACKSLASH] = geom->stride + 1;
+  geom->shifts[LD_FORWARD_SLASH] = geom->stride - 1;
+
+  bb_clear(&geom->squares);
+  for (int i = 0; i < geom->numSquares; i++) {
+    bb_set(&geom->squares, geom_bit(geom, i));
+  }
+}
+
+/**
+ * @brief converts a square's board position (row * cols + col) to its
+ * bit index
+ */
+int geom_bit(Geometry *geom, int pos) {
+  return pos + (pos / geom->cols);
+}
+
+/**
+ * @brief converts a bit index back to a board position
+ */
+int geom_pos(Geometry *geom, int bit) {
+  return bit - (bit / geom->stride);
+}
+
+void bb_clear(Bitboard *b) {
+  memset(b->w, 0, sizeof(b->w));
+}
+
+bool bb_is_empty(Bitboard *b) {
+  for (int i = 0; i < BB_WORDS; i++) {
+    if (b->w[i] != 0) return false;
+  }
+
+  return true;
+}
+
+bool bb_equal(Bitboard *a, Bitboard *b) {
+  for (int i = 0; i < BB_WORDS; i++) {
+    if (a->w[i] != b->w[i]) return false;
+  }
+
+  return true;
+}
+
+bool bb_test(Bitboard *b, int bit) {
+  return (b->w[bit >> 6] >> (bit & 63)) & 1;
+}
+
+void bb_set(Bitboard *b, int bit) {
+  b->w[bit >> 6] |= (uint64_t)1 << (bit & 63);
+}
+
+void bb_unset(Bitboard *b, int bit) {
+  b->w[bit >> 6] &= ~((uint64_t)1 << (bit & 63));
+}
+
+int bb_count(Bitboard *b) {
+  int count = 0;
+  for (int i = 0; i < BB_WORDS; i++) {
+    count += __builtin_popcountll(b->w[i]);
+  }
+
+  return count;
+}
+
+/**
+ * @brief returns the index of the nth (from 0) set bit, or -1
+ */
+int bb_nth_bit(Bitboard *b, int n) {
+  for (int i = 0; i < BB_WORDS; i++) {
+    uint64_t w = b->w[i];
+    int count = __builtin_popcountll(w);
+
+    if (n >= count) {
+      n -= count;
+      continue;
+    }
+
+    // drop the lowest set bits until the one we want is lowest
+    for (int j = 0; j < n; j++) {
+      w &= w - 1;
+    }
+
+    return (i << 6) + __builtin_ctzll(w);
+  }
+
+  return -1;
+}
+
+int bb_first_bit(Bitboard *b) {
+  return bb_nth_bit(b, 0);
+}
+
+void bb_and(Bitboard *tgt, Bitboard *a, Bitboard *b) {
+  for (int i = 0; i < BB_WORDS; i++) {
+    tgt->w[i] = a->w[i] & b->w[i];
+  }
+}
+
+void bb_or(Bitboard *tgt, Bitboard *a, Bitboard *b) {
+  for (int i = 0; i < BB_WORDS; i++) {
+    tgt->w[i] = a->w[i] | b->w[i];
+  }
+}
+
+void bb_andnot(Bitboard *tgt, Bitboard *a, Bitboard *b) {
+  for (int i = 0; i < BB_WORDS; i++) {
+    tgt->w[i] = a->w[i] & ~b->w[i];
+  }
+}
+
+/**
+ * @brief shifts the whole bitboard towards bit 0 by n bits, or away from
+ * it when n is negative, so that bit i of tgt is bit i + n of src
+ *
+ * @param tgt may be the same as src
+ * @param src
+ * @param n
+ */
+void bb_shift(Bitboard *tgt, Bitboard *src, int n) {
+  Bitboard r;
+  bb_clear(&r);
+
+  if (n >= 0) {
+    int words = n >> 6;
+    int bits = n & 63;
+
+    for (int i = 0; i + words < BB_WORDS; i++) {
+      r.w[i] = src->w[i + words] >> bits;
+      if (bits != 0 && i + words + 1 < BB_WORDS) {
+        r.w[i] |= src->w[i + words + 1] << (64 - bits);
+      }
+    }
+  } else {
+    n = -n;
+    int words = n >> 6;
+    int bits = n & 63;
+
+    for (int i = BB_WORDS - 1; i - words >= 0; i--) {
+      r.w[i] = src->w[i - words] << bits;
+      if (bits != 0 && i - words - 1 >= 0) {
+        r.w[i] |= src->w[i - words - 1] >> (64 - bits);
+      }
+    }
+  }
+
+  *tgt = r;
+}
+
+/**
+ * @brief checks whether the pieces in b contain k in a row along any
+ * direction. After the loop, bit p of m is set only if p and the k - 1
+ * squares after it on the line are all set in b
+ *
+ * @param geom
+ * @param b
+ * @return true
+ * @return false
+ */
+bool bb_has_line(Geometry *geom, Bitboard *b) {
+  Bitboard m, shifted;
+
+  for (int d = 0; d < 4; d++) {
+    m = *b;
+
+    for (int i = 1; i < geom->k && !bb_is_empty(&m); i++) {
+      bb_shift(&shifted, b, i * geom->shifts[d]);
+      bb_and(&m, &m, &shifted);
+    }
+
+    if (!bb_is_empty(&m)) return true;
+  }
+
+  return false;
+}
+
+/**
+ * @brief finds every empty square that would complete k in a row for the
+ * pieces in b. For each direction and each slot j the empty square could
+ * fill in the line, the other k - 1 squares are shifted onto it and and-ed
+ * together
+ *
+ * @param geom
+ * @param b
+ * @param empty
+ * @param tgt
+ */
+void bb_winning_squares(Geometry *geom, Bitboard *b, Bitboard *empty, Bitboard *tgt) {
+  Bitboard candidates, shifted;
+  bb_clear(tgt);
+
+  for (int d = 0; d < 4; d++) {
+    int step = geom->shifts[d];
+
+    for (int j = 0; j < geom->k; j++) {
+      candidates = *empty;
+
+      for (int i = 0; i < geom->k && !bb_is_empty(&candidates); i++) {
+        if (i == j) continue;
+        bb_shift(&shifted, b, (i - j) * step);
+        bb_and(&candidates, &candidates, &shifted);
+      }
+
+      bb_or(tgt, tgt, &candidates);
+    }
+  }
+}
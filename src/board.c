@@ -1,64 +1,25 @@
 #include <stdlib.h>
+#include <stdio.h>
 #include <stdbool.h>
+#include <string.h>
 
 #include "game.h"
-#include "display.h"
 
-Board *new_board() {
-  Board *b = malloc(sizeof(Board));
+bool is_valid_board_size(int rows, int cols, int k) {
+  if (rows < 1 || rows > MAX_BOARD_DIM) return false;
+  if (cols < 1 || cols > MAX_BOARD_DIM) return false;
 
-  for (int i = 0; i < 9; i++) {
-    b->squares[i] = malloc(sizeof(Square));
-    b->squares[i]->loc = new_location(0, 0);
-    b->squares[i]->piece = PIECE_EMPTY;
-    b->squares[i]->color = SQ_NONE;
-  }
-
-  // top-left
-  b->squares[0]->loc->row = BOARD_ORIGIN_ROW;
-  b->squares[0]->loc->col = BOARD_ORIGIN_COL + 1;
-
-  // top-center
-  b->squares[1]->loc->row = BOARD_ORIGIN_ROW;
-  b->squares[1]->loc->col = BOARD_ORIGIN_COL + 2 + BOARD_COL_GAP;
-
-  // top-right
-  b->squares[2]->loc->row = BOARD_ORIGIN_ROW;
-  b->squares[2]->loc->col = BOARD_ORIGIN_COL + 3 + (BOARD_COL_GAP * 2);
-
-  // middle-left
-  b->squares[3]->loc->row = BOARD_ORIGIN_ROW + 2;
-  b->squares[3]->loc->col = BOARD_ORIGIN_COL + 1;
-
-  // middle-center
-  b->squares[4]->loc->row = BOARD_ORIGIN_ROW + 2;
-  b->squares[4]->loc->col = BOARD_ORIGIN_COL + 2 + BOARD_COL_GAP;
-
-  // middle-right
-  b->squares[5]->loc->row = BOARD_ORIGIN_ROW + 2;
-  b->squares[5]->loc->col = BOARD_ORIGIN_COL + 3 + (BOARD_COL_GAP * 2);
-
-  // bottom-left
-  b->squares[6]->loc->row = BOARD_ORIGIN_ROW + 4;
-  b->squares[6]->loc->col = BOARD_ORIGIN_COL + 1;
-
-  // bottom-center
-  b->squares[7]->loc->row = BOARD_ORIGIN_ROW + 4;
-  b->squares[7]->loc->col = BOARD_ORIGIN_COL + 2 + BOARD_COL_GAP;
-
-  // bottom-right
-  b->squares[8]->loc->row = BOARD_ORIGIN_ROW + 4;
-  b->squares[8]->loc->col = BOARD_ORIGIN_COL + 3 + (BOARD_COL_GAP * 2);
-
-  return b;
+  // a line longer than the board could never be completed
+  return k >= 1 && (k <= rows || k <= cols);
 }
 
-void destroy_board(Board *b) {
-  for (int i = 0; i < 9; i++) {
-    destroy_location(b->squares[i]->loc);
-    free(b->squares[i]);
-  }
-  free(b);
+void init_board(Board *b, int rows, int cols, int k) {
+  b->rows = rows;
+  b->cols = cols;
+  b->k = k;
+  b->numSquares = rows * cols;
+
+  reset_board(b);
 }
 
 void reset_square(Square *s) {
@@ -67,30 +28,30 @@ void reset_square(Square *s) {
 }
 
 void reset_board(Board *b) {
-  for (int i = 0; i < 9; i++) {
-    reset_square(b->squares[i]);
+  for (int i = 0; i < b->numSquares; i++) {
+    reset_square(&b->squares[i]);
   }
 }
 
 int num_empty_squares(Board *b) {
   int count = 0;
-  for (int i = 0; i < 9; i++) {
-    if (b->squares[i]->piece == PIECE_EMPTY) count++;
+  for (int i = 0; i < b->numSquares; i++) {
+    if (b->squares[i].piece == PIECE_EMPTY) count++;
   }
   return count;
 }
 
 static bool validate_new_piece(Board *b, int pos, Piece p) {
   // is the requested square occupied?
-  if (pos < 0 || pos > 8) return false;
-  if (b->squares[pos]->piece != PIECE_EMPTY) return false;
+  if (pos < 0 || pos >= b->numSquares) return false;
+  if (b->squares[pos].piece != PIECE_EMPTY) return false;
 
   int numX = 0;
   int numO = 0;
 
-  for (int i = 0; i < 9; i++) {
-    if (b->squares[i]->piece == PIECE_X) numX++;
-    if (b->squares[i]->piece == PIECE_O) numO++;
+  for (int i = 0; i < b->numSquares; i++) {
+    if (b->squares[i].piece == PIECE_X) numX++;
+    if (b->squares[i].piece == PIECE_O) numO++;
   }
 
   // X's and O's must be equivalent
@@ -105,19 +66,51 @@ static bool validate_new_piece(Board *b, int pos, Piece p) {
 BoardPlacementResult place_piece(Board *b, int pos, Piece p) {
   if (!validate_new_piece(b, pos, p)) return BPR_INVALID;
 
-  b->squares[pos]->piece = p;
+  b->squares[pos].piece = p;
   return BPR_OK;
 }
 
-int get_board_pos_from_cursor(Board *b, Cursor *c) {
-  int pos;
+/**
+ * @brief fills the board from a string with one character per square,
+ * read left to right and top to bottom. 'X' and 'O' are pieces, '.', '-',
+ * '_' and ' ' are empty squares
+ * 
+ * @param b 
+ * @param s 
+ * @return true if the string describes a legal position
+ */
+bool parse_board(Board *b, const char *s) {
+  int numX = 0;
+  int numO = 0;
 
-  for (int i = 0; i < 9; i++) {
-    Square *s = b->squares[i];
-    if (s->loc->row == c->loc->row && s->loc->col == c->loc->col) return i;
+  if (strlen(s) != (size_t)b->numSquares) return false;
+
+  for (int i = 0; i < b->numSquares; i++) {
+    switch (s[i]) {
+      case 'X':
+      case 'x':
+        b->squares[i].piece = PIECE_X;
+        numX++;
+        break;
+      case 'O':
+      case 'o':
+        b->squares[i].piece = PIECE_O;
+        numO++;
+        break;
+      case '.':
+      case '-':
+      case '_':
+      case ' ':
+        b->squares[i].piece = PIECE_EMPTY;
+        break;
+      default:
+        return false;
+    }
+    b->squares[i].color = SQ_NONE;
   }
 
-  return -1;
+  // X always moves first
+  return numX == numO || numX == numO + 1;
 }
 
 char get_piece_char(Piece p) {
@@ -135,50 +128,54 @@ char get_piece_char_from_square(Square *s) {
   return get_piece_char(s->piece);
 }
 
-void set_top_row_color(Board *b, SquareColor c) {
-  b->squares[0]->color = c;
-  b->squares[1]->color = c;
-  b->squares[2]->color = c;
-}
+void print_board(Board *b, const char *msg) {
+  printf("===== Tic Tac Toe =====\n");
+  printf("== State: %s\n\n", msg);
 
-void set_middle_row_color(Board *b, SquareColor c) {
-  b->squares[3]->color = c;
-  b->squares[4]->color = c;
-  b->squares[5]->color = c;
-}
+  for (int r = 0; r < b->rows; r++) {
+    if (r > 0) {
+      for (int c = 0; c < b->cols; c++) {
+        printf(c == 0 ? "---" : "|---");
+      }
+      printf("\n");
+    }
 
-void set_bottom_row_color(Board *b, SquareColor c) {
-  b->squares[6]->color = c;
-  b->squares[7]->color = c;
-  b->squares[8]->color = c;
+    for (int c = 0; c < b->cols; c++) {
+      printf(c == 0 ? " %c " : "| %c ", get_piece_char_from_square(&b->squares[(r * b->cols) + c]));
+    }
+    printf("\n");
+  }
 }
 
-void set_left_col_color(Board *b, SquareColor c) {
-  b->squares[0]->color = c;
-  b->squares[3]->color = c;
-  b->squares[6]->color = c;
-}
+/**
+ * @brief returns the distance between neighbouring squares on the line
+ * 
+ * @param b 
+ * @param l 
+ * @return int 
+ */
+int get_line_step(Board *b, Line l) {
+  switch (LINE_DIRECTION(l)) {
+    case LD_ROW:
+      return 1;
+    case LD_COL:
+      return b->cols;
+    case LD_BACKSLASH:
+      return b->cols + 1;
+    case LD_FORWARD_SLASH:
+      return b->cols - 1;
+  }
 
-void set_center_col_color(Board *b, SquareColor c) {
-  b->squares[1]->color = c;
-  b->squares[4]->color = c;
-  b->squares[7]->color = c;
+  return 0;
 }
 
-void set_right_col_color(Board *b, SquareColor c) {
-  b->squares[2]->color = c;
-  b->squares[5]->color = c;
-  b->squares[8]->color = c;
-}
+void set_line_color(Board *b, Line l, SquareColor c) {
+  if (l == NO_WINNER) return;
 
-void set_backslash_color(Board *b, SquareColor c) {
-  b->squares[0]->color = c;
-  b->squares[4]->color = c;
-  b->squares[8]->color = c;
-}
+  int pos = LINE_START(l);
+  int step = get_line_step(b, l);
 
-void set_forwardslash_color(Board *b, SquareColor c) {
-  b->squares[6]->color = c;
-  b->squares[4]->color = c;
-  b->squares[2]->color = c;
-}
\ No newline at end of file
+  for (int i = 0; i < b->k; i++) {
+    b->squares[pos + (i * step)].color = c;
+  }
+}
@@ -0,0 +1,164 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "book.h"
+#include "alloc.h"
+
+/*
+  The book is loaded once at startup and only read afterwards, so any
+  number of threads can probe it. Only the counters are shared writes.
+*/
+typedef struct Book {
+  int fd;
+  const BookHeader *header;
+  const BookEntry *entries;
+  size_t size;
+  Rules rules;
+} Book;
+
+static Book *book = NULL;
+static atomic_long bookHits = 0;
+static atomic_long bookMisses = 0;
+
+/**
+ * @brief checks that the header describes a board the rules can be set
+ * up for, and that it's the board being played
+ *
+ * @param h
+ * @param variant
+ * @param rows
+ * @param cols
+ * @param k
+ * @return true if the book is for this game
+ */
+static bool is_book_for_game(const BookHeader *h, GameVariant variant, int rows, int cols, int k) {
+  if (h->variant != GV_STANDARD && h->variant != GV_ULTIMATE) return false;
+  if (!is_valid_board_size(h->rows, h->cols, h->k)) return false;
+  if (h->variant == GV_ULTIMATE && (h->rows != ULTIMATE_SIZE || h->cols != ULTIMATE_SIZE || h->k != ULTIMATE_DIM)) return false;
+
+  return h->variant == variant && h->rows == rows && h->cols == cols && h->k == k;
+}
+
+/**
+ * @brief maps an opening book into memory. Only the header is read, so
+ * this takes the same time whatever the size of the book
+ *
+ * @param path
+ * @param variant the game the book will be probed for, books made for
+ * any other game are rejected
+ * @param rows
+ * @param cols
+ * @param k
+ * @return true if the book was loaded
+ */
+bool load_opening_book(const char *path, GameVariant variant, int rows, int cols, int k) {
+  unload_opening_book();
+
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) return false;
+
+  struct stat st;
+  if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(BookHeader)) {
+    close(fd);
+    return false;
+  }
+
+  void *data = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  if (data == MAP_FAILED) {
+    close(fd);
+    return false;
+  }
+
+  const BookHeader *h = data;
+  size_t expected = sizeof(BookHeader) + ((size_t)h->count * sizeof(BookEntry));
+
+  if (memcmp(h->magic, BOOK_MAGIC, 4) != 0 || h->version != BOOK_VERSION || expected != (size_t)st.st_size || !is_book_for_game(h, variant, rows, cols, k)) {
+    munmap(data, st.st_size);
+    close(fd);
+    return false;
+  }
+
+  book = ttt_malloc(sizeof(Book));
+  book->fd = fd;
+  book->header = h;
+  book->entries = (const BookEntry*)(h + 1);
+  book->size = st.st_size;
+  init_rules(&book->rules, h->variant, h->rows, h->cols, h->k);
+
+  return true;
+}
+
+void unload_opening_book() {
+  if (book == NULL) return;
+
+  munmap((void*)book->header, book->size);
+  close(book->fd);
+  ttt_free(book);
+  book = NULL;
+}
+
+static const BookEntry *find_entry(uint64_t key) {
+  long lo = 0;
+  long hi = (long)book->header->count - 1;
+
+  while (lo <= hi) {
+    long mid = lo + ((hi - lo) / 2);
+    uint64_t midKey = book->entries[mid].key;
+
+    if (midKey == key) return &book->entries[mid];
+    if (midKey < key) {
+      lo = mid + 1;
+    } else {
+      hi = mid - 1;
+    }
+  }
+
+  return NULL;
+}
+
+/**
+ * @brief looks up the game's position in the opening book
+ *
+ * @param g
+ * @return int the book move mapped onto the real board, -1 if the
+ * position isn't in the book (or the book is for another board type)
+ */
+int probe_opening_book(Game *g) {
+  if (book == NULL) return -1;
+
+  Rules *r = &book->rules;
+  if (g->variant != r->variant || g->board.rows != r->geom.rows || g->board.cols != r->geom.cols || g->board.k != r->geom.k) return -1;
+
+  Position pos;
+  int sym;
+  game_to_position(r, g, &pos);
+
+  const BookEntry *e = find_entry(get_canonical_key(r, &pos, &sym));
+
+  if (e != NULL && e->move < r->geom.numSquares) {
+    // the entry's move is for the canonical form, undo the symmetry
+    int bit = transform_bit(r, inverse_symmetry(sym), geom_bit(&r->geom, e->move));
+
+    Bitboard legal;
+    get_legal_moves(r, &pos, &legal);
+
+    if (bb_test(&legal, bit)) {
+      atomic_fetch_add(&bookHits, 1);
+      return geom_pos(&r->geom, bit);
+    }
+  }
+
+  atomic_fetch_add(&bookMisses, 1);
+
+  return -1;
+}
+
+void get_opening_book_stats(long *hits, long *misses) {
+  *hits = atomic_load(&bookHits);
+  *misses = atomic_load(&bookMisses);
+}
@@ -0,0 +1,196 @@
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "cache.h"
+#include "alloc.h"
+
+typedef struct StatsCache {
+  int fd;
+  CacheHeader *header;
+  CacheSlot *slots;
+  uint64_t mask;
+  size_t size;
+} StatsCache;
+
+static StatsCache *cache = NULL;
+static _Atomic uint64_t cacheHits = 0;
+static _Atomic uint64_t cacheMisses = 0;
+static _Atomic uint64_t cacheDropped = 0;
+
+static size_t get_cache_size(int slotBits) {
+  return sizeof(CacheHeader) + ((size_t)1 << slotBits) * sizeof(CacheSlot);
+}
+
+/**
+ * @brief opens the statistics cache at path, creating it with 2^slotBits
+ * slots if it doesn't exist yet. An existing cache keeps its own size
+ *
+ * @param path
+ * @param slotBits
+ * @return true if the cache is ready to use
+ */
+bool open_stats_cache(const char *path, int slotBits) {
+  close_stats_cache();
+
+  int fd = open(path, O_RDWR | O_CREAT, 0644);
+  if (fd < 0) return false;
+
+  struct stat st;
+  if (fstat(fd, &st) < 0) {
+    close(fd);
+    return false;
+  }
+
+  if (st.st_size == 0) {
+    // a new cache: the table stays sparse until slots are written
+    CacheHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, CACHE_MAGIC, 4);
+    h.version = CACHE_VERSION;
+    h.slotBits = slotBits;
+
+    if (ftruncate(fd, get_cache_size(slotBits)) < 0 || pwrite(fd, &h, sizeof(h), 0) != sizeof(h)) {
+      close(fd);
+      return false;
+    }
+  } else {
+    CacheHeader h;
+    if (pread(fd, &h, sizeof(h), 0) != sizeof(h) || memcmp(h.magic, CACHE_MAGIC, 4) != 0 || h.version != CACHE_VERSION || h.slotBits > 32 || get_cache_size(h.slotBits) != (size_t)st.st_size) {
+      close(fd);
+      return false;
+    }
+    slotBits = h.slotBits;
+  }
+
+  size_t size = get_cache_size(slotBits);
+  void *data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (data == MAP_FAILED) {
+    close(fd);
+    return false;
+  }
+
+  cache = ttt_malloc(sizeof(StatsCache));
+  cache->fd = fd;
+  cache->header = data;
+  cache->slots = (CacheSlot*)(cache->header + 1);
+  cache->mask = ((uint64_t)1 << slotBits) - 1;
+  cache->size = size;
+
+  return true;
+}
+
+void close_stats_cache() {
+  if (cache == NULL) return;
+
+  msync(cache->header, cache->size, MS_ASYNC);
+  munmap(cache->header, cache->size);
+  close(cache->fd);
+  ttt_free(cache);
+  cache = NULL;
+}
+
+bool is_stats_cache_open() {
+  return cache != NULL;
+}
+
+static uint64_t get_slot_key(uint64_t key) {
+  // 0 marks a free slot
+  return key == 0 ? 1 : key;
+}
+
+/**
+ * @brief finds the slot for key, claiming a free one if create is set
+ *
+ * @param key
+ * @param create
+ * @return CacheSlot* NULL if it isn't there, or there's no room for it
+ */
+static CacheSlot *find_slot(uint64_t key, bool create) {
+  key = get_slot_key(key);
+
+  for (int i = 0; i < CACHE_MAX_PROBES; i++) {
+    CacheSlot *s = &cache->slots[(key + i) & cache->mask];
+    uint64_t found = atomic_load_explicit(&s->key, memory_order_acquire);
+
+    if (found == key) return s;
+
+    if (found == 0) {
+      if (!create) return NULL;
+
+      uint64_t expected = 0;
+      if (atomic_compare_exchange_strong(&s->key, &expected, key) || expected == key) return s;
+    }
+  }
+
+  return NULL;
+}
+
+static int get_slot_count(_Atomic uint32_t *count) {
+  uint32_t n = atomic_load(count);
+
+  return n > INT_MAX ? INT_MAX : (int)n;
+}
+
+/**
+ * @brief looks up the statistics gathered for a position in earlier
+ * searches
+ *
+ * @param key
+ * @param visits
+ * @param wins
+ * @param draws
+ * @return true if the position has been seen before
+ */
+bool lookup_cached_stats(uint64_t key, int *visits, int *wins, int *draws) {
+  if (cache == NULL) return false;
+
+  CacheSlot *s = find_slot(key, false);
+  if (s == NULL || atomic_load(&s->visits) == 0) {
+    atomic_fetch_add(&cacheMisses, 1);
+    return false;
+  }
+
+  *visits = get_slot_count(&s->visits);
+  *wins = get_slot_count(&s->wins);
+  *draws = get_slot_count(&s->draws);
+  atomic_fetch_add(&cacheHits, 1);
+
+  return true;
+}
+
+/**
+ * @brief adds a search's stats for a position. A slot that already has
+ * CACHE_MAX_VISITS visits is left as it is, so its counters stay well
+ * short of wrapping
+ *
+ * @param key
+ * @param visits
+ * @param wins
+ * @param draws
+ */
+void add_cached_stats(uint64_t key, int visits, int wins, int draws) {
+  if (cache == NULL || visits <= 0) return;
+
+  CacheSlot *s = find_slot(key, true);
+  if (s == NULL) {
+    atomic_fetch_add(&cacheDropped, 1);
+    return;
+  }
+
+  if (atomic_load(&s->visits) >= CACHE_MAX_VISITS) return;
+
+  atomic_fetch_add(&s->visits, visits);
+  atomic_fetch_add(&s->wins, wins);
+  atomic_fetch_add(&s->draws, draws);
+}
+
+void get_stats_cache_counts(uint64_t *hits, uint64_t *misses, uint64_t *dropped) {
+  *hits = atomic_load(&cacheHits);
+  *misses = atomic_load(&cacheMisses);
+  *dropped = atomic_load(&cacheDropped);
+}
@@ -7,9 +7,27 @@
 #define SUCCESS_PAIR 1
 #define FAIL_PAIR 2
 
-static void paint_board(Board *b, Cursor *c);
+/*
+  What is currently on the screen. Each refresh only repaints the parts
+  that differ from it, the grid and menu labels are drawn once per board.
+*/
+typedef struct Frame {
+  bool valid;
+  Board *board;                   // board the static parts were drawn for
+  BoardView view;
+  int statusCells[ULTIMATE_SIZE]; // see get_cell
+  GameState state;
+  int menuPos;
+  long latencyCount;              // replies the latency line was drawn for
+} Frame;
+
+static Frame frame = { .valid = false };
+
+static void paint_static(Game *g, int block);
+static void paint_ultimate_status(Game *g);
 static void paint_header(Game *g);
-static void paint_menu(Game *g);
+static void paint_menu(Game *g, Cursor *c);
+static void paint_latency(Game *g, ReplyLatency *l);
 
 void init_display() {
   initscr();
@@ -22,42 +40,170 @@ void init_display() {
   init_pair(FAIL_PAIR, COLOR_RED, COLOR_BLACK);
 }
 
-void refresh_display(Game *g) {
+/**
+ * @brief brings the screen up to date with the game
+ * 
+ * @param g 
+ * @param c 
+ * @param latency the CPU's reply times to show under the menu, may be NULL
+ */
+void refresh_display(Game *g, Cursor *c, ReplyLatency *latency) {
+  int block = g->variant == GV_ULTIMATE ? ULTIMATE_DIM : 0;
+
+  if (!frame.valid || frame.board != &g->board || frame.view.block != block) {
+    paint_static(g, block);
+  }
+
   paint_header(g);
-  paint_board(g->board, g->cursor);
-  paint_menu(g);
+  paint_board_view(&frame.view, &g->board, c);
+  if (g->variant == GV_ULTIMATE) paint_ultimate_status(g);
+  paint_menu(g, c);
+  if (latency != NULL) paint_latency(g, latency);
 
   refresh();
 }
 
+/**
+ * @brief forgets what is on the screen so the next refresh repaints
+ * everything, e.g. after the terminal was resized
+ */
+void invalidate_display() {
+  frame.valid = false;
+}
+
 void kill_display() {
   endwin();
 }
 
-static bool is_cursor_on_square(Cursor *c, Square *s) {
-  return c->loc->row == s->loc->row && c->loc->col == s->loc->col;
+/**
+ * @brief sets up a board to be drawn with its top-left corner at the
+ * given screen position. Nothing is drawn until paint_board_view
+ * 
+ * @param v 
+ * @param row 
+ * @param col 
+ * @param block heavier grid lines every block squares, 0 for none
+ */
+void init_board_view(BoardView *v, int row, int col, int block) {
+  v->row = row;
+  v->col = col;
+  v->block = block;
+  v->gridDrawn = false;
+
+  for (int i = 0; i < MAX_SQUARES; i++) {
+    v->cells[i] = -1;
+  }
 }
 
-static void paint_board(Board *b, Cursor *c) {
+/**
+ * @brief draws the grid lines. If block is set, every block-th line is
+ * drawn heavier to mark out the sub-boards
+ * 
+ * @param v 
+ * @param b 
+ */
+static void paint_grid(BoardView *v, Board *b) {
+  int width = BOARD_WIDTH(b->cols);
+  int height = BOARD_HEIGHT(b->rows);
+
   // horizontal lines
-  mvprintw(BOARD_ORIGIN_ROW + BOARD_ROW_GAP, BOARD_ORIGIN_COL, "-----------");
-  mvprintw(BOARD_ORIGIN_ROW + (BOARD_ROW_GAP * 2) + 1, BOARD_ORIGIN_COL, "-----------");
-
-  // left vertical
-  mvprintw(BOARD_ORIGIN_ROW, BOARD_ORIGIN_COL + BOARD_COL_GAP, "|");
-  mvprintw(BOARD_ORIGIN_ROW + 2, BOARD_ORIGIN_COL + BOARD_COL_GAP, "|");
-  mvprintw(BOARD_ORIGIN_ROW + 4, BOARD_ORIGIN_COL + BOARD_COL_GAP, "|");
-
-  // right vertical
-  mvprintw(BOARD_ORIGIN_ROW, BOARD_ORIGIN_COL + (BOARD_COL_GAP * 2) + 1, "|");
-  mvprintw(BOARD_ORIGIN_ROW + 2, BOARD_ORIGIN_COL + (BOARD_COL_GAP * 2) + 1, "|");
-  mvprintw(BOARD_ORIGIN_ROW + 4, BOARD_ORIGIN_COL + (BOARD_COL_GAP * 2) + 1, "|");
-
-  // draw pieces
-  for (int i = 0; i < 9; i++) {
-    Square *s = b->squares[i];
+  for (int r = 1; r < b->rows; r++) {
+    int row = v->row + (r * (BOARD_ROW_GAP + 1)) - 1;
+    chtype line = v->block > 0 && r % v->block == 0 ? '=' : '-';
+    move(row, v->col);
+    for (int i = 0; i < width; i++) {
+      addch(line);
+    }
+  }
+
+  // vertical lines, between every pair of columns
+  for (int c = 1; c < b->cols; c++) {
+    int col = v->col + (c * (BOARD_COL_GAP + 1)) - 1;
+    const char *line = v->block > 0 && c % v->block == 0 ? "#" : "|";
+    for (int row = 0; row < height; row += BOARD_ROW_GAP + 1) {
+      mvprintw(v->row + row, col, "%s", line);
+    }
+  }
+
+  v->gridDrawn = true;
+}
+
+/**
+ * @brief clears the screen and draws everything that doesn't change
+ * during a game, then marks every other part of the frame as stale
+ * 
+ * @param g 
+ * @param block 
+ */
+static void paint_static(Game *g, int block) {
+  Location newGame, quit;
+  get_menu_location(&g->board, 0, &newGame);
+  get_menu_location(&g->board, 1, &quit);
+
+  erase();
+  init_board_view(&frame.view, BOARD_ORIGIN_ROW, BOARD_ORIGIN_COL, block);
+
+  mvprintw(newGame.row, newGame.col + MENU_PADDING, "Start new game");
+  mvprintw(quit.row, quit.col + MENU_PADDING, "Quit");
+
+  if (g->variant == GV_ULTIMATE) {
+    int row = BOARD_ORIGIN_ROW;
+    int col = BOARD_ORIGIN_COL + BOARD_WIDTH(g->board.cols) + 1 + ULTIMATE_STATUS_GAP;
+
+    mvprintw(row, col, "Boards");
+    mvprintw(row + 3 + ULTIMATE_DIM, col, "* play here");
+    mvprintw(row + 4 + ULTIMATE_DIM, col, "# drawn");
+  }
+
+  frame.valid = true;
+  frame.board = &g->board;
+  frame.state = -1;
+  frame.menuPos = -2;
+  frame.latencyCount = -1;
+
+  for (int i = 0; i < ULTIMATE_SIZE; i++) {
+    frame.statusCells[i] = -1;
+  }
+}
+
+/**
+ * @brief packs everything that decides how a cell is drawn into one int
+ * so it can be compared against the last frame
+ * 
+ * @param ch 
+ * @param color 
+ * @param isCursor 
+ * @return int 
+ */
+static int get_cell(char ch, SquareColor color, bool isCursor) {
+  return (unsigned char)ch | (color << 8) | (isCursor << 12);
+}
+
+/**
+ * @brief draws the board at the view's position. The grid is drawn the
+ * first time, after that only squares that changed since the last call
+ * are repainted
+ * 
+ * @param v 
+ * @param b 
+ * @param c the cursor to show, may be NULL
+ */
+void paint_board_view(BoardView *v, Board *b, Cursor *c) {
+  if (!v->gridDrawn) paint_grid(v, b);
+
+  int cursorPos = c == NULL || c->ctx != CURCTX_BOARD ? -1 : c->pos;
+
+  for (int i = 0; i < b->numSquares; i++) {
+    Square *s = &b->squares[i];
     char p = get_piece_char_from_square(s);
-    bool isCursor = is_cursor_on_square(c, s);
+    bool isCursor = i == cursorPos;
+
+    int cell = get_cell(p, s->color, isCursor);
+    if (v->cells[i] == cell) continue;
+    v->cells[i] = cell;
+
+    int row = v->row + ((i / b->cols) * (BOARD_ROW_GAP + 1));
+    int col = v->col + 1 + ((i % b->cols) * (BOARD_COL_GAP + 1));
 
     if (s->color == SQ_RED) {
       attron(COLOR_PAIR(FAIL_PAIR));
@@ -66,12 +212,12 @@ static void paint_board(Board *b, Cursor *c) {
     }
 
     if (isCursor && s->piece == PIECE_EMPTY) {
-      mvprintw(s->loc->row, s->loc->col, "%s", CURSOR_SQUARE);
+      mvprintw(row, col, "%s", CURSOR_SQUARE);
     } else if (isCursor && s->piece != PIECE_EMPTY) {
-      move(s->loc->row, s->loc->col);
+      move(row, col);
       addch(p | A_UNDERLINE);
     } else {
-      move(s->loc->row, s->loc->col);
+      move(row, col);
       addch(p);
     }
 
@@ -83,9 +229,58 @@ static void paint_board(Board *b, Cursor *c) {
   }
 }
 
+/**
+ * @brief draws the meta-board next to the grid: who won each sub-board,
+ * which ones are drawn, and which ones the next move can go in
+ * 
+ * @param g 
+ */
+static void paint_ultimate_status(Game *g) {
+  Ultimate *u = g->ultimate;
+  int row = BOARD_ORIGIN_ROW;
+  int col = BOARD_ORIGIN_COL + BOARD_WIDTH(g->board.cols) + 1 + ULTIMATE_STATUS_GAP;
+  bool playing = g->state == GS_PLAYER_TURN || g->state == GS_CPU_TURN;
+
+  for (int sub = 0; sub < ULTIMATE_SIZE; sub++) {
+    Square *s = &u->meta.squares[sub];
+    char status = '.';
+
+    if (s->piece != PIECE_EMPTY) {
+      status = get_piece_char_from_square(s);
+    } else if (is_sub_board_closed(u, sub)) {
+      status = '#';
+    } else if (playing && (u->target < 0 || u->target == sub)) {
+      status = '*';
+    }
+
+    int cell = get_cell(status, s->color, false);
+    if (frame.statusCells[sub] == cell) continue;
+    frame.statusCells[sub] = cell;
+
+    if (s->color == SQ_RED) {
+      attron(COLOR_PAIR(FAIL_PAIR));
+    } else if (s->color == SQ_GREEN) {
+      attron(COLOR_PAIR(SUCCESS_PAIR));
+    }
+
+    move(row + 2 + (sub / ULTIMATE_DIM), col + ((sub % ULTIMATE_DIM) * 2));
+    addch(status);
+
+    if (s->color == SQ_RED) {
+      attroff(COLOR_PAIR(FAIL_PAIR));
+    } else if (s->color == SQ_GREEN) {
+      attroff(COLOR_PAIR(SUCCESS_PAIR));
+    }
+  }
+}
+
 static void paint_header(Game *g) {
   int row = BOARD_ORIGIN_ROW - 2;
   int col = BOARD_ORIGIN_COL;
+
+  if (frame.state == g->state) return;
+  frame.state = g->state;
+
   move(row, col);
   clrtoeol();
 
@@ -108,35 +303,59 @@ static void paint_header(Game *g) {
   }
 }
 
-static void paint_menu(Game *g) {
-  Menu *m = g->menu;
-  int row = m->items[0]->loc->row;
-  int col = m->items[0]->loc->col;
+/**
+ * @brief moves the '>' marker between menu items. The labels themselves
+ * are drawn by paint_static
+ * 
+ * @param g 
+ * @param c 
+ */
+static void paint_menu(Game *g, Cursor *c) {
+  int pos = c->ctx == CURCTX_MENU ? c->pos : -1;
+  Location l;
 
-  move(row, col);
-  clrtoeol();
-  mvprintw(row, col + MENU_PADDING, "Start new game");
+  if (frame.menuPos == pos) return;
 
-  row = m->items[1]->loc->row;
-  col = m->items[1]->loc->col;
-  move(row, col);
-  clrtoeol();
-  mvprintw(row, col + MENU_PADDING, "Quit");
-
-  int pos = get_menu_pos_from_cursor(g->menu, g->cursor);
+  if (frame.menuPos >= 0) {
+    get_menu_location(&g->board, frame.menuPos, &l);
+    move(l.row, l.col);
+    addch(' ');
+  }
 
   if (pos >= 0) {
-    move(m->items[pos]->loc->row, m->items[pos]->loc->col);
+    get_menu_location(&g->board, pos, &l);
+    move(l.row, l.col);
     addch('>');
   }
+
+  frame.menuPos = pos;
 }
 
-void print_board(Board *b, const char *msg) {
-  printf("===== Tic Tac Toe =====\n");
-  printf("== State: %s\n\n", msg);
-  printf(" %c | %c | %c\n", get_piece_char_from_square(b->squares[0]), get_piece_char_from_square(b->squares[1]), get_piece_char_from_square(b->squares[2]));
-  printf("---|---|---\n");
-  printf(" %c | %c | %c\n", get_piece_char_from_square(b->squares[3]), get_piece_char_from_square(b->squares[4]), get_piece_char_from_square(b->squares[5]));
-  printf("---|---|---\n");
-  printf(" %c | %c | %c\n", get_piece_char_from_square(b->squares[6]), get_piece_char_from_square(b->squares[7]), get_piece_char_from_square(b->squares[8]));
-}
\ No newline at end of file
+/**
+ * @brief draws the CPU's reply times on a line below the menu. Nothing
+ * is drawn until the CPU has replied once
+ * 
+ * @param g 
+ * @param l 
+ */
+static void paint_latency(Game *g, ReplyLatency *l) {
+  LatencyHistogram *h = &l->replies;
+  Location quit;
+
+  if (frame.latencyCount == (long)h->count) return;
+  frame.latencyCount = (long)h->count;
+
+  get_menu_location(&g->board, MENU_ITEMS - 1, &quit);
+  int row = quit.row + MENU_BOARD_GAP;
+
+  move(row, MENU_ORIGIN_COL);
+  clrtoeol();
+  if (h->count == 0) return;
+
+  mvprintw(row, MENU_ORIGIN_COL, "CPU reply p50 %.1fms  p99 %.1fms  max %.1fms",
+    get_latency_percentile(h, 50.) / 1000., get_latency_percentile(h, 99.) / 1000., h->max / 1000.);
+
+  if (l->targetMs > 0) {
+    printw("  (target %dms, %llu over)", l->targetMs, (unsigned long long)l->overTarget);
+  }
+}
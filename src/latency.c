@@ -0,0 +1,204 @@
+#include <stdlib.h>
+#include <time.h>
+
+#include "latency.h"
+
+// widest bar print_latency_histogram draws
+#define LATENCY_BAR_WIDTH 40
+
+uint64_t get_clock_us() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  return ((uint64_t)now.tv_sec * 1000000) + ((uint64_t)now.tv_nsec / 1000);
+}
+
+void init_latency_histogram(LatencyHistogram *h) {
+  for (int i = 0; i < LATENCY_BUCKETS; i++) {
+    h->counts[i] = 0;
+  }
+
+  h->count = 0;
+  h->min = 0;
+  h->max = 0;
+  h->total = 0;
+}
+
+/**
+ * @brief the bucket a value falls in. The first LATENCY_SUB_BUCKETS
+ * buckets are one microsecond wide, after that each power of two gets
+ * LATENCY_SUB_BUCKETS buckets of equal width
+ *
+ * @param us at most LATENCY_MAX_US
+ * @return int
+ */
+static int get_bucket(uint64_t us) {
+  if (us < LATENCY_SUB_BUCKETS) return (int)us;
+
+  int msb = 63 - __builtin_clzll(us);
+  int shift = msb - LATENCY_SUB_BITS;
+
+  return ((shift + 1) * LATENCY_SUB_BUCKETS) + (int)((us >> shift) - LATENCY_SUB_BUCKETS);
+}
+
+/**
+ * @brief the largest value that falls in the bucket
+ *
+ * @param bucket
+ * @return uint64_t
+ */
+static uint64_t get_bucket_limit(int bucket) {
+  int group = bucket / LATENCY_SUB_BUCKETS;
+  uint64_t sub = bucket % LATENCY_SUB_BUCKETS;
+
+  if (group == 0) return sub;
+
+  int shift = group - 1;
+
+  return ((LATENCY_SUB_BUCKETS + sub + 1) << shift) - 1;
+}
+
+void record_latency(LatencyHistogram *h, uint64_t us) {
+  if (us > LATENCY_MAX_US) us = LATENCY_MAX_US;
+
+  h->counts[get_bucket(us)]++;
+
+  if (h->count == 0 || us < h->min) h->min = us;
+  if (us > h->max) h->max = us;
+  h->count++;
+  h->total += us;
+}
+
+/**
+ * @brief the value at or below which the given percent of the recorded
+ * values fall. Like HdrHistogram this is the top of the bucket the
+ * value landed in, but never more than the largest value recorded
+ *
+ * @param h
+ * @param percentile 0 to 100
+ * @return uint64_t microseconds, 0 if nothing was recorded
+ */
+uint64_t get_latency_percentile(const LatencyHistogram *h, double percentile) {
+  if (h->count == 0) return 0;
+  if (percentile <= 0.) return h->min;
+
+  double exact = percentile / 100. * h->count;
+  uint64_t rank = (uint64_t)exact;
+  if (rank < exact || rank < 1) rank++;
+  if (rank > h->count) rank = h->count;
+
+  uint64_t seen = 0;
+  for (int i = 0; i < LATENCY_BUCKETS; i++) {
+    seen += h->counts[i];
+    if (seen >= rank) {
+      uint64_t limit = get_bucket_limit(i);
+      return limit < h->max ? limit : h->max;
+    }
+  }
+
+  return h->max;
+}
+
+/**
+ * @brief writes a summary line, then one line per non-empty bucket with
+ * its upper limit, count, cumulative percent and a bar
+ *
+ * @param h
+ * @param out
+ */
+void print_latency_histogram(const LatencyHistogram *h, FILE *out) {
+  if (h->count == 0) {
+    fprintf(out, "  no moves timed\n");
+    return;
+  }
+
+  fprintf(out, "  %llu moves, mean %.1fms, p50 %.1fms, p90 %.1fms, p99 %.1fms, max %.1fms\n",
+    (unsigned long long)h->count, (double)h->total / h->count / 1000.,
+    get_latency_percentile(h, 50.) / 1000., get_latency_percentile(h, 90.) / 1000.,
+    get_latency_percentile(h, 99.) / 1000., h->max / 1000.);
+
+  uint32_t most = 0;
+  for (int i = 0; i < LATENCY_BUCKETS; i++) {
+    if (h->counts[i] > most) most = h->counts[i];
+  }
+
+  uint64_t seen = 0;
+  for (int i = 0; i < LATENCY_BUCKETS; i++) {
+    if (h->counts[i] == 0) continue;
+    seen += h->counts[i];
+
+    int bar = (int)(((uint64_t)h->counts[i] * LATENCY_BAR_WIDTH + most - 1) / most);
+
+    fprintf(out, "  <= %9.2fms %6u %6.1f%% ", get_bucket_limit(i) / 1000., h->counts[i], 100. * seen / h->count);
+    for (int b = 0; b < bar; b++) fputc('#', out);
+    fputc('\n', out);
+  }
+}
+
+void init_reply_latency(ReplyLatency *l, int targetMs) {
+  init_latency_histogram(&l->replies);
+  l->targetMs = targetMs;
+  l->budgetMs = targetMs;
+  l->overTarget = 0;
+}
+
+/**
+ * @brief records a reply and, if there is a target, moves the budget
+ * for the next one towards it
+ *
+ * @param l
+ * @param us how long the reply took
+ */
+void record_reply(ReplyLatency *l, uint64_t us) {
+  record_latency(&l->replies, us);
+  if (l->targetMs <= 0) return;
+
+  double ms = us / 1000.;
+
+  if (ms > l->targetMs) {
+    l->overTarget++;
+    int budget = (int)(l->budgetMs * (l->targetMs / ms) * LATENCY_BACKOFF);
+    l->budgetMs = budget < 1 ? 1 : budget;
+  } else {
+    l->budgetMs += (int)((l->targetMs - ms) * LATENCY_RECOVERY);
+    if (l->budgetMs > l->targetMs) l->budgetMs = l->targetMs;
+  }
+}
+
+void print_reply_latency(const ReplyLatency *l, FILE *out) {
+  const LatencyHistogram *h = &l->replies;
+
+  print_latency_histogram(h, out);
+
+  if (l->targetMs > 0 && h->count > 0) {
+    fprintf(out, "  target %dms: %.1f%% of replies met it, %llu over, last budget %dms\n", l->targetMs,
+      100. * (h->count - l->overTarget) / h->count, (unsigned long long)l->overTarget, l->budgetMs);
+  }
+}
+
+static double get_clock_ms_on(clockid_t clock) {
+  struct timespec ts;
+  clock_gettime(clock, &ts);
+
+  return (ts.tv_sec * 1000.) + (ts.tv_nsec / 1e6);
+}
+
+/**
+ * @brief sets a deadline ms from now
+ *
+ * @param d
+ * @param clock CLOCK_THREAD_CPUTIME_ID or CLOCK_MONOTONIC
+ * @param ms 0 or less for no deadline
+ */
+void set_deadline(Deadline *d, clockid_t clock, int ms) {
+  d->clock = clock;
+  d->ms = ms > 0 ? get_clock_ms_on(clock) + ms : 0.;
+}
+
+bool has_deadline(const Deadline *d) {
+  return d != NULL && d->ms > 0;
+}
+
+bool is_past_deadline(const Deadline *d) {
+  return has_deadline(d) && get_clock_ms_on(d->clock) >= d->ms;
+}
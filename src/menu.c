@@ -3,35 +3,23 @@
 #include "game.h"
 #include "display.h"
 
-Menu *new_menu() {
-  Menu *m = malloc(sizeof(Menu));
-  int rowSpacing = 0;
+static const MenuAction menuActions[MENU_ITEMS] = { MENU_NEW_GAME, MENU_QUIT };
 
-  for (int i = 0; i < 2; i++) {
-    m->items[i] = malloc(sizeof(MenuItem));
-    m->items[i]->loc = new_location(MENU_ORIGIN_ROW + rowSpacing, MENU_ORIGIN_COL);
-    rowSpacing += MENU_ROW_GAP;
-  }
-
-  m->items[0]->menuAction = MENU_NEW_GAME;
-  m->items[1]->menuAction = MENU_QUIT;
-
-  return m;
+MenuAction get_menu_action(int item) {
+  return menuActions[item];
 }
 
-void destroy_menu(Menu *m) {
-  for (int i = 0; i < 2; i++) {
-    destroy_location(m->items[i]->loc);
-    free(m->items[i]);
-  }
-  
-  free(m);
+/**
+ * @brief works out where a menu item goes on the screen. The menu sits
+ * below the last row of the board
+ * 
+ * @param b 
+ * @param item 
+ * @param l 
+ */
+void get_menu_location(Board *b, int item, Location *l) {
+  int lastRow = BOARD_ORIGIN_ROW + ((b->rows - 1) * (BOARD_ROW_GAP + 1));
+
+  l->row = lastRow + MENU_BOARD_GAP + (item * MENU_ROW_GAP);
+  l->col = MENU_ORIGIN_COL;
 }
-
-int get_menu_pos_from_cursor(Menu *m, Cursor *c) {
-  for (int i = 0; i < 2; i++) {
-    if (c->loc->row == m->items[i]->loc->row) return i;
-  }
-
-  return -1;
-}
\ No newline at end of file
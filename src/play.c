@@ -0,0 +1,307 @@
+#include <stdlib.h>
+#include <ncurses.h>
+
+#include "game.h"
+#include "display.h"
+#include "ai.h"
+#include "record.h"
+
+static UserAction get_menu_action_from_cursor(Cursor *c) {
+  switch (get_menu_action(c->pos)) {
+    case MENU_NEW_GAME:
+      return UA_NEW_GAME;
+    case MENU_QUIT:
+      return UA_QUIT;
+  }
+
+  return UA_NONE;
+}
+
+/**
+ * @brief The user selected the action button. This function determines
+ * what action the user wishes to take
+ * 
+ * @param c 
+ * @return UserAction 
+ */
+static UserAction determine_user_cursor_action(Cursor *c) {
+  switch (c->ctx) {
+    case CURCTX_BOARD:
+      return UA_PLACE_PIECE;
+    case CURCTX_MENU:
+      return get_menu_action_from_cursor(c);
+  }
+
+  return UA_NONE;
+}
+
+/**
+ * @brief determines which action the user wants to take based on
+ * the game's current state, the cursor context, and the user's input
+ * 
+ * @param c 
+ * @param in 
+ * @return UserAction 
+ */
+static UserAction get_user_action(Cursor *c, UserInput in) {
+  switch (in) {
+    case UI_NONE:
+      return UA_NONE;
+    case UI_Q:
+      return UA_QUIT;
+    case UI_UP:
+      return UA_CURSOR_UP;
+    case UI_DOWN:
+      return UA_CURSOR_DOWN;
+    case UI_LEFT:
+      return UA_CURSOR_LEFT;
+    case UI_RIGHT:
+      return UA_CURSOR_RIGHT;
+    case UI_ENTER:
+      return determine_user_cursor_action(c);
+  }
+
+  return UA_NONE;
+}
+
+static UserInput parse_user_input(int c) {
+  switch (c) {
+    case 81:
+    case 113:
+      return UI_Q;
+    case KEY_UP:
+      return UI_UP;
+    case KEY_DOWN:
+      return UI_DOWN;
+    case KEY_LEFT:
+      return UI_LEFT;
+    case KEY_RIGHT:
+      return UI_RIGHT;
+    case 32:
+      return UI_ENTER;
+    default:
+      return UI_NONE;
+  }
+}
+
+/**
+ * @brief places the player's piece under the cursor
+ * 
+ * @param g 
+ * @param c 
+ * @return int the square played, -1 if the move wasn't legal or it
+ * isn't the player's turn
+ */
+static int user_place_piece(Game *g, Cursor *c) {
+  int pos = c->pos;
+
+  // the board stays up after a game ends, but it can't be played on
+  if (g->state != GS_PLAYER_TURN) return -1;
+
+  if (place_game_piece(g, pos, PIECE_X) != BPR_OK) return -1;
+
+  advance_search_tree(g, pos);
+
+  return pos;
+}
+
+static void move_cursor_to_menu(Cursor *c) {
+  c->ctx = CURCTX_MENU;
+  c->pos = 0;
+}
+
+static void move_cursor_to_board(Cursor *c, Board* b) {
+  c->ctx = CURCTX_BOARD;
+
+  // move the cursor to the bottom left square
+  c->pos = (b->rows - 1) * b->cols;
+}
+
+static void move_cursor_from_board(Board *b, Cursor *c, CursorDirection d) {
+  int pos = c->pos;
+  int newPos;
+
+  switch (d) {
+    case CUR_UP:
+      newPos = pos - b->cols;
+      break;
+    case CUR_DOWN:
+      newPos = pos + b->cols;
+      break;
+    // allowing wraparound movement
+    case CUR_LEFT:
+      newPos = pos - 1;
+      break;
+    case CUR_RIGHT:
+      newPos = pos + 1;
+      break;
+    default:
+      newPos = pos;
+  }
+
+  if (newPos >= b->numSquares) {
+    move_cursor_to_menu(c);
+    return;
+  } else if (newPos < 0) {
+    newPos = pos;
+  }
+
+  c->pos = newPos;
+}
+
+static void move_cursor_from_menu(Board *b, Cursor *c, CursorDirection d) {
+  int pos = c->pos;
+  int newPos;
+
+  switch (d) {
+    case CUR_UP:
+      newPos = pos - 1;
+      break;
+    case CUR_DOWN:
+      newPos = pos + 1;
+      break;
+    default:
+      newPos = pos;
+  }
+
+  if (newPos < 0) {
+    move_cursor_to_board(c, b);
+    return;
+  } else if (newPos >= MENU_ITEMS) {
+    newPos = MENU_ITEMS - 1;
+  }
+
+  c->pos = newPos;
+}
+
+static void move_cursor(Board *b, Cursor *c, CursorDirection d) {
+  switch (c->ctx) {
+    case CURCTX_BOARD:
+      move_cursor_from_board(b, c, d);
+      break;
+    case CURCTX_MENU:
+      move_cursor_from_menu(b, c, d);
+      break;
+  }
+}
+
+static bool is_game_over(Game *g) {
+  return g->state == GS_END_X || g->state == GS_END_O || g->state == GS_END_TIE;
+}
+
+/**
+ * @brief appends the game to the record log, once. Games that were
+ * abandoned part way through are kept too, unless nothing was played
+ * 
+ * @param g 
+ * @param rec 
+ * @param recordFd -1 if games aren't being logged
+ */
+static void log_game(Game *g, GameRecord *rec, int recordFd) {
+  if (recordFd < 0 || rec->numMoves == 0) return;
+
+  finish_game_record(rec, g->state);
+  write_game_record(recordFd, rec);
+  rec->numMoves = 0;
+}
+
+/**
+ * @brief the game loop. The CPU's replies are timed from the player's
+ * placement into latency, and with a target each search gets the
+ * latency's current budget
+ * 
+ * @param g 
+ * @param recordFd -1 if games aren't being logged
+ * @param latency 
+ */
+void play(Game *g, int recordFd, ReplyLatency *latency) {
+  Cursor cursor = { CURCTX_BOARD, 0 };
+
+  update_game_state(g);
+  refresh_display(g, &cursor, latency);
+
+  int input;
+  bool pondering = true;
+
+  GameRecord rec;
+  start_game_record(&rec, g, RE_MCTS, RF_HUMAN_X);
+
+  // when the player's last piece went down, the CPU's reply is timed from it
+  uint64_t placedAt = 0;
+
+  while (true) {
+    // don't block on input while there's still thinking to do
+    timeout(pondering ? 0 : -1);
+    input = getch();
+
+    if (input == ERR) {
+      pondering = ponder(g);
+      continue;
+    }
+
+    UserInput in = parse_user_input(input);
+    switch (get_user_action(&cursor, in)) {
+      case UA_QUIT:
+        log_game(g, &rec, recordFd);
+        return;
+      case UA_NONE:
+        continue;
+      case UA_PLACE_PIECE: {
+        int pos = user_place_piece(g, &cursor);
+        if (pos >= 0) {
+          placedAt = get_clock_us();
+          add_record_move(&rec, pos);
+        }
+        break;
+      }
+      case UA_NEW_GAME:
+        log_game(g, &rec, recordFd);
+        reset_game(g);
+        start_game_record(&rec, g, RE_MCTS, RF_HUMAN_X);
+        break;
+      case UA_CURSOR_UP:
+        move_cursor(&g->board, &cursor, CUR_UP);
+        break;
+      case UA_CURSOR_DOWN:
+        move_cursor(&g->board, &cursor, CUR_DOWN);
+        break;
+      case UA_CURSOR_LEFT:
+        move_cursor(&g->board, &cursor, CUR_LEFT);
+        break;
+      case UA_CURSOR_RIGHT:
+        move_cursor(&g->board, &cursor, CUR_RIGHT);
+        break;
+    }
+
+    update_game_state(g);
+    refresh_display(g, &cursor, latency);
+
+    // AI logic
+    if (g->state == GS_CPU_TURN) {
+      uint64_t thinkStart = get_clock_us();
+      int cpuMove = get_next_move_within(g, latency->budgetMs);
+      rec.engineMs += (uint32_t)((get_clock_us() - thinkStart) / 1000);
+
+      place_game_piece(g, cpuMove, PIECE_O);
+      advance_search_tree(g, cpuMove);
+      add_record_move(&rec, cpuMove);
+
+      update_game_state(g);
+      record_reply(latency, get_clock_us() - (placedAt > 0 ? placedAt : thinkStart));
+      refresh_display(g, &cursor, latency);
+    }
+
+    if (is_game_over(g)) log_game(g, &rec, recordFd);
+
+    pondering = g->state == GS_PLAYER_TURN;
+
+    /*
+      check for an ending condition
+      set game state to GS_CPU_TURN if the player played a piece
+      run CPU logic
+      refresh display
+      check for an ending condition
+      repeat
+    */
+  }
+}
\ No newline at end of file
@@ -0,0 +1,321 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "record.h"
+#include "alloc.h"
+
+uint64_t get_clock_ms() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  return ((uint64_t)now.tv_sec * 1000) + ((uint64_t)now.tv_nsec / 1000000);
+}
+
+/**
+ * @brief starts recording a game from the game's current (usually empty)
+ * board
+ *
+ * @param r
+ * @param g
+ * @param engine
+ * @param flags RF_* bits saying which sides are human
+ */
+void start_game_record(GameRecord *r, Game *g, RecordEngine engine, int flags) {
+  r->variant = g->variant;
+  r->rows = g->board.rows;
+  r->cols = g->board.cols;
+  r->k = g->board.k;
+  r->result = RR_UNFINISHED;
+  r->engine = engine;
+  r->flags = flags;
+  r->startTime = (uint32_t)time(NULL);
+  r->durationMs = 0;
+  r->engineMs = 0;
+  r->numMoves = 0;
+  r->startedAtMs = get_clock_ms();
+}
+
+void add_record_move(GameRecord *r, int pos) {
+  if (r->numMoves < MAX_SQUARES) r->moves[r->numMoves++] = (uint8_t)pos;
+}
+
+void finish_game_record(GameRecord *r, GameState state) {
+  switch (state) {
+    case GS_END_X:
+      r->result = RR_X;
+      break;
+    case GS_END_O:
+      r->result = RR_O;
+      break;
+    case GS_END_TIE:
+      r->result = RR_TIE;
+      break;
+    default:
+      r->result = RR_UNFINISHED;
+      break;
+  }
+
+  r->durationMs = (uint32_t)(get_clock_ms() - r->startedAtMs);
+}
+
+/**
+ * @brief the file games are logged to: $TTT_RECORDS if set (an empty
+ * value turns logging off), otherwise DEFAULT_RECORD_FILE in $HOME
+ *
+ * @return const char* NULL if games shouldn't be logged
+ */
+const char *get_record_path() {
+  static char path[4096];
+
+  const char *env = getenv("TTT_RECORDS");
+  if (env != NULL) return env[0] == '\0' ? NULL : env;
+
+  const char *home = getenv("HOME");
+  if (home == NULL) return NULL;
+
+  snprintf(path, sizeof(path), "%s/%s", home, DEFAULT_RECORD_FILE);
+
+  return path;
+}
+
+/**
+ * @brief checks a record file header
+ *
+ * @param header RECORD_FILE_HEADER_SIZE bytes
+ * @return true if it's a record file this version can read and extend
+ */
+static bool is_record_header(const uint8_t *header) {
+  return memcmp(header, RECORD_MAGIC, 4) == 0 && header[4] == RECORD_VERSION;
+}
+
+/**
+ * @brief opens a record file for appending, writing the file header if
+ * the file is new. Records are written with a single write() to an
+ * O_APPEND descriptor, so several threads or processes can share a file.
+ * An existing file of another version is left alone
+ *
+ * @param path
+ * @return int the file descriptor, -1 on error
+ */
+int open_record_log(const char *path) {
+  int fd = open(path, O_WRONLY | O_APPEND | O_CREAT | O_EXCL, 0644);
+
+  if (fd >= 0) {
+    uint8_t header[RECORD_FILE_HEADER_SIZE] = { 0 };
+    memcpy(header, RECORD_MAGIC, 4);
+    header[4] = RECORD_VERSION;
+
+    if (write(fd, header, sizeof(header)) != sizeof(header)) {
+      close(fd);
+      return -1;
+    }
+
+    return fd;
+  }
+
+  if (errno != EEXIST) return -1;
+
+  fd = open(path, O_RDWR | O_APPEND);
+  if (fd < 0) return -1;
+
+  uint8_t header[RECORD_FILE_HEADER_SIZE];
+  if (pread(fd, header, sizeof(header), 0) != sizeof(header) || !is_record_header(header)) {
+    close(fd);
+    errno = EINVAL;
+    return -1;
+  }
+
+  return fd;
+}
+
+static void put_u16(uint8_t *p, uint16_t v) {
+  p[0] = v & 0xFF;
+  p[1] = v >> 8;
+}
+
+static void put_u32(uint8_t *p, uint32_t v) {
+  for (int i = 0; i < 4; i++) {
+    p[i] = (v >> (i * 8)) & 0xFF;
+  }
+}
+
+static uint16_t get_u16(const uint8_t *p) {
+  return p[0] | (p[1] << 8);
+}
+
+static uint32_t get_u32(const uint8_t *p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/**
+ * @brief writes v as a varint
+ *
+ * @param p room for 5 bytes
+ * @param v
+ * @return int bytes written
+ */
+static int put_varint(uint8_t *p, uint32_t v) {
+  int n = 0;
+
+  while (v >= 0x80) {
+    p[n++] = (v & 0x7F) | 0x80;
+    v >>= 7;
+  }
+  p[n++] = v;
+
+  return n;
+}
+
+/**
+ * @brief reads a varint that has to end before end
+ *
+ * @param p
+ * @param end
+ * @param v
+ * @return int bytes read, 0 if it runs past end or is too long
+ */
+static int get_varint(const uint8_t *p, const uint8_t *end, uint32_t *v) {
+  *v = 0;
+
+  for (int n = 0; n < 5 && p + n < end; n++) {
+    *v |= (uint32_t)(p[n] & 0x7F) << (7 * n);
+    if ((p[n] & 0x80) == 0) return n + 1;
+  }
+
+  return 0;
+}
+
+bool write_game_record(int fd, GameRecord *r) {
+  uint8_t buf[RECORD_MAX_HEADER_SIZE + MAX_SQUARES];
+
+  buf[2] = ((r->rows - 1) << 4) | (r->cols - 1);
+  buf[3] = ((r->k - 1) << 4) | (r->variant << 2) | r->result;
+  buf[4] = (r->engine << 2) | r->flags;
+  put_u32(buf + 5, r->startTime);
+
+  int size = RECORD_HEADER_SIZE;
+  size += put_varint(buf + size, r->durationMs);
+  size += put_varint(buf + size, r->engineMs);
+  memcpy(buf + size, r->moves, r->numMoves);
+  size += r->numMoves;
+
+  put_u16(buf, size - 2);
+
+  return write(fd, buf, size) == size;
+}
+
+/**
+ * @brief maps a record file into memory for reading
+ *
+ * @param path
+ * @return RecordFile* NULL if the file can't be opened or isn't a record file
+ */
+RecordFile *open_record_file(const char *path) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) return NULL;
+
+  struct stat st;
+  if (fstat(fd, &st) < 0 || st.st_size < RECORD_FILE_HEADER_SIZE) {
+    close(fd);
+    return NULL;
+  }
+
+  void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (data == MAP_FAILED) {
+    close(fd);
+    return NULL;
+  }
+
+  if (!is_record_header(data)) {
+    munmap(data, st.st_size);
+    close(fd);
+    return NULL;
+  }
+
+  // records are read in order, let the kernel read ahead
+  madvise(data, st.st_size, MADV_SEQUENTIAL);
+
+  RecordFile *f = ttt_malloc(sizeof(RecordFile));
+  f->fd = fd;
+  f->data = data;
+  f->size = st.st_size;
+
+  return f;
+}
+
+void close_record_file(RecordFile *f) {
+  munmap((void*)f->data, f->size);
+  close(f->fd);
+  ttt_free(f);
+}
+
+/**
+ * @brief skips over the record at offset using only its size prefix.
+ * Start from RECORD_FILE_HEADER_SIZE and stop once the offset reaches
+ * the end of the file
+ *
+ * @param f
+ * @param offset
+ * @return size_t offset of the following record, f->size at the end of
+ * the file or if the record is cut short
+ */
+size_t next_record_offset(RecordFile *f, size_t offset) {
+  if (offset + 2 > f->size) return f->size;
+
+  size_t next = offset + 2 + get_u16(f->data + offset);
+
+  return next > f->size ? f->size : next;
+}
+
+/**
+ * @brief decodes the record at offset
+ *
+ * @param f
+ * @param offset
+ * @param r
+ * @return true if a complete, well formed record was there
+ */
+bool read_game_record(RecordFile *f, size_t offset, GameRecord *r) {
+  if (offset + RECORD_HEADER_SIZE > f->size) return false;
+
+  const uint8_t *p = f->data + offset;
+  int size = get_u16(p) + 2;
+
+  if (offset + size > f->size || size < RECORD_HEADER_SIZE) return false;
+
+  const uint8_t *end = p + size;
+  const uint8_t *q = p + RECORD_HEADER_SIZE;
+  uint32_t durationMs, engineMs;
+  int n;
+
+  if ((n = get_varint(q, end, &durationMs)) == 0) return false;
+  q += n;
+  if ((n = get_varint(q, end, &engineMs)) == 0) return false;
+  q += n;
+
+  int numMoves = (int)(end - q);
+  if (numMoves > MAX_SQUARES) return false;
+
+  r->rows = (p[2] >> 4) + 1;
+  r->cols = (p[2] & 0x0F) + 1;
+  r->k = (p[3] >> 4) + 1;
+  r->variant = (p[3] >> 2) & 0x01;
+  r->result = p[3] & 0x03;
+  r->engine = (p[4] >> 2) & 0x03;
+  r->flags = p[4] & 0x03;
+  r->startTime = get_u32(p + 5);
+  r->durationMs = durationMs;
+  r->engineMs = engineMs;
+  r->numMoves = numMoves;
+  memcpy(r->moves, q, numMoves);
+  r->startedAtMs = 0;
+
+  return true;
+}
@@ -0,0 +1,227 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "rules.h"
+
+// the 8 lines of a 3x3 board, one bit per square (row * 3 + col)
+static const uint16_t SUB_LINES[8] = {
+  0x007, 0x038, 0x1C0,  // rows
+  0x049, 0x092, 0x124,  // columns
+  0x111, 0x054          // backslash, forward slash
+};
+
+static bool has_meta_line(uint16_t won) {
+  for (int i = 0; i < 8; i++) {
+    if ((won & SUB_LINES[i]) == SUB_LINES[i]) return true;
+  }
+
+  return false;
+}
+
+static void init_ultimate_masks(Rules *r) {
+  Geometry *geom = &r->geom;
+
+  for (int sub = 0; sub < ULTIMATE_SIZE; sub++) {
+    bb_clear(&r->subSquares[sub]);
+
+    for (int square = 0; square < ULTIMATE_SIZE; square++) {
+      bb_set(&r->subSquares[sub], geom_bit(geom, get_ultimate_pos(sub, square)));
+    }
+
+    for (int l = 0; l < 8; l++) {
+      bb_clear(&r->subLines[sub][l]);
+
+      for (int square = 0; square < ULTIMATE_SIZE; square++) {
+        if (SUB_LINES[l] & (1 << square)) {
+          bb_set(&r->subLines[sub][l], geom_bit(geom, get_ultimate_pos(sub, square)));
+        }
+      }
+    }
+  }
+}
+
+void init_rules(Rules *r, GameVariant variant, int rows, int cols, int k) {
+  r->variant = variant;
+
+  if (variant == GV_ULTIMATE) {
+    init_geometry(&r->geom, ULTIMATE_SIZE, ULTIMATE_SIZE, ULTIMATE_DIM);
+    init_ultimate_masks(r);
+  } else {
+    init_geometry(&r->geom, rows, cols, k);
+  }
+
+  init_symmetries(r);
+}
+
+static bool is_sub_board_full(Rules *r, Position *p, int sub) {
+  Bitboard filled;
+  bb_or(&filled, &p->pieces[PIECE_X], &p->pieces[PIECE_O]);
+  bb_and(&filled, &filled, &r->subSquares[sub]);
+
+  return bb_equal(&filled, &r->subSquares[sub]);
+}
+
+/**
+ * @brief converts the game's board (and ultimate bookkeeping) into a
+ * position
+ *
+ * @param r
+ * @param g
+ * @param p
+ */
+void game_to_position(Rules *r, Game *g, Position *p) {
+  Board *b = &g->board;
+
+  memset(p, 0, sizeof(Position));
+  p->target = -1;
+
+  for (int i = 0; i < b->numSquares; i++) {
+    Piece piece = b->squares[i].piece;
+    if (piece != PIECE_EMPTY) bb_set(&p->pieces[piece], geom_bit(&r->geom, i));
+  }
+
+  if (r->variant != GV_ULTIMATE) return;
+
+  Ultimate *u = g->ultimate;
+
+  for (int sub = 0; sub < ULTIMATE_SIZE; sub++) {
+    Piece winner = u->meta.squares[sub].piece;
+    if (winner != PIECE_EMPTY) p->subWon[winner] |= 1 << sub;
+
+    if (winner != PIECE_EMPTY || is_sub_board_full(r, p, sub)) p->subClosed |= 1 << sub;
+  }
+
+  p->target = u->target;
+}
+
+bool is_same_position(Position *a, Position *b) {
+  return bb_equal(&a->pieces[PIECE_X], &b->pieces[PIECE_X])
+    && bb_equal(&a->pieces[PIECE_O], &b->pieces[PIECE_O])
+    && a->target == b->target;
+}
+
+/**
+ * @brief sets every square the side to move may play in
+ *
+ * @param r
+ * @param p
+ * @param moves
+ */
+void get_legal_moves(Rules *r, Position *p, Bitboard *moves) {
+  Bitboard occupied;
+  bb_or(&occupied, &p->pieces[PIECE_X], &p->pieces[PIECE_O]);
+
+  if (r->variant != GV_ULTIMATE) {
+    bb_andnot(moves, &r->geom.squares, &occupied);
+    return;
+  }
+
+  // nothing can be played once the meta-board is decided
+  bb_clear(moves);
+  if (has_meta_line(p->subWon[PIECE_X]) || has_meta_line(p->subWon[PIECE_O])) return;
+
+  for (int sub = 0; sub < ULTIMATE_SIZE; sub++) {
+    if (p->subClosed & (1 << sub)) continue;
+    if (p->target >= 0 && p->target != sub) continue;
+
+    Bitboard open;
+    bb_andnot(&open, &r->subSquares[sub], &occupied);
+    bb_or(moves, moves, &open);
+  }
+}
+
+/**
+ * @brief finds the legal moves that would complete a line for piece: k in
+ * a row on a standard board, or a sub-board line in ultimate
+ *
+ * @param r
+ * @param p
+ * @param piece
+ * @param legal
+ * @param tgt
+ */
+void get_winning_moves(Rules *r, Position *p, Piece piece, Bitboard *legal, Bitboard *tgt) {
+  if (r->variant != GV_ULTIMATE) {
+    bb_winning_squares(&r->geom, &p->pieces[piece], legal, tgt);
+    return;
+  }
+
+  bb_clear(tgt);
+
+  for (int sub = 0; sub < ULTIMATE_SIZE; sub++) {
+    if (p->subClosed & (1 << sub)) continue;
+    if (p->target >= 0 && p->target != sub) continue;
+
+    for (int l = 0; l < 8; l++) {
+      Bitboard *line = &r->subLines[sub][l];
+      Bitboard own, gap;
+
+      // two of the line's squares taken and the third one playable
+      bb_and(&own, &p->pieces[piece], line);
+      if (bb_count(&own) != 2) continue;
+
+      bb_andnot(&gap, line, &own);
+      bb_and(&gap, &gap, legal);
+      bb_or(tgt, tgt, &gap);
+    }
+  }
+}
+
+/**
+ * @brief plays piece on the given bit, which must be a legal move
+ *
+ * @param r
+ * @param p
+ * @param bit
+ * @param piece
+ * @return Piece the piece if the move won the game, PIECE_EMPTY otherwise
+ */
+Piece play_move(Rules *r, Position *p, int bit, Piece piece) {
+  bb_set(&p->pieces[piece], bit);
+
+  if (r->variant != GV_ULTIMATE) {
+    return bb_has_line(&r->geom, &p->pieces[piece]) ? piece : PIECE_EMPTY;
+  }
+
+  int pos = geom_pos(&r->geom, bit);
+  int sub = get_sub_board(pos);
+  int square = get_sub_square(pos);
+  Piece winner = PIECE_EMPTY;
+
+  for (int l = 0; l < 8; l++) {
+    Bitboard own;
+    bb_and(&own, &p->pieces[piece], &r->subLines[sub][l]);
+
+    if (bb_equal(&own, &r->subLines[sub][l])) {
+      p->subWon[piece] |= 1 << sub;
+      p->subClosed |= 1 << sub;
+      if (has_meta_line(p->subWon[piece])) winner = piece;
+      break;
+    }
+  }
+
+  if (is_sub_board_full(r, p, sub)) p->subClosed |= 1 << sub;
+
+  p->target = (p->subClosed & (1 << square)) ? -1 : square;
+
+  return winner;
+}
+
+/**
+ * @brief checks whether the position has already been won
+ *
+ * @param r
+ * @param p
+ * @return Piece
+ */
+Piece get_position_winner(Rules *r, Position *p) {
+  for (Piece piece = PIECE_X; piece <= PIECE_O; piece++) {
+    if (r->variant == GV_ULTIMATE) {
+      if (has_meta_line(p->subWon[piece])) return piece;
+    } else if (bb_has_line(&r->geom, &p->pieces[piece])) {
+      return piece;
+    }
+  }
+
+  return PIECE_EMPTY;
+}
@@ -0,0 +1,144 @@
+#include <stdlib.h>
+
+#include "solver.h"
+
+typedef struct Solver {
+  Rules *r;
+  long nodes;
+  long maxNodes;
+  const Deadline *deadline;   // NULL for none
+  bool aborted;     // ran out of nodes, the scores can't be trusted
+} Solver;
+
+static Piece other_piece(Piece p) {
+  return p == PIECE_X ? PIECE_O : PIECE_X;
+}
+
+static int take_bits(Bitboard *b, int *order, int n) {
+  while (!bb_is_empty(b)) {
+    int bit = bb_first_bit(b);
+    bb_unset(b, bit);
+    order[n++] = bit;
+  }
+
+  return n;
+}
+
+/**
+ * @brief lists the moves in the order they're most likely to be good
+ * in: wins first, then blocks of the opponent's wins, then the rest.
+ * The sooner a good move is tried the more alpha-beta can prune
+ *
+ * @param s
+ * @param p
+ * @param turn
+ * @param moves
+ * @param order
+ * @return int the number of moves
+ */
+static int order_moves(Solver *s, Position *p, Piece turn, Bitboard *moves, int *order) {
+  Bitboard wins, blocks, rest;
+
+  get_winning_moves(s->r, p, turn, moves, &wins);
+  get_winning_moves(s->r, p, other_piece(turn), moves, &blocks);
+
+  bb_andnot(&blocks, &blocks, &wins);
+  bb_andnot(&rest, moves, &wins);
+  bb_andnot(&rest, &rest, &blocks);
+
+  int n = take_bits(&wins, order, 0);
+  n = take_bits(&blocks, order, n);
+
+  return take_bits(&rest, order, n);
+}
+
+/**
+ * @brief negamax with alpha-beta pruning
+ *
+ * @param s
+ * @param p
+ * @param turn the side to move
+ * @param ply moves played since the root
+ * @param alpha
+ * @param beta
+ * @param bestBit set to the best move's bit if not NULL
+ * @return int the score for the side to move
+ */
+static int negamax(Solver *s, Position *p, Piece turn, int ply, int alpha, int beta, int *bestBit) {
+  if (++s->nodes > s->maxNodes || (s->nodes % SOLVER_CLOCK_INTERVAL == 0 && is_past_deadline(s->deadline))) {
+    s->aborted = true;
+    return 0;
+  }
+
+  Bitboard moves;
+  get_legal_moves(s->r, p, &moves);
+  if (bb_is_empty(&moves)) return 0;
+
+  int order[MAX_SQUARES];
+  int numMoves = order_moves(s, p, turn, &moves, order);
+  int best = -SOLVER_WIN - 1;
+
+  for (int i = 0; i < numMoves; i++) {
+    Position child = *p;
+    int score;
+
+    if (play_move(s->r, &child, order[i], turn) == turn) {
+      // nothing beats winning right away
+      score = SOLVER_WIN - (ply + 1);
+    } else {
+      score = -negamax(s, &child, other_piece(turn), ply + 1, -beta, -alpha, NULL);
+    }
+
+    if (s->aborted) return 0;
+
+    if (score > best) {
+      best = score;
+      if (bestBit != NULL) *bestBit = order[i];
+    }
+
+    if (best > alpha) alpha = best;
+    if (alpha >= beta) break;
+  }
+
+  return best;
+}
+
+/**
+ * @brief solves the position exactly, if that can be done within
+ * maxNodes positions and before the deadline
+ *
+ * @param r
+ * @param p
+ * @param turn the side to move
+ * @param maxNodes
+ * @param deadline NULL for none
+ * @param result
+ * @return true if the position was solved, false if it ran out of nodes
+ * or time, or the game is already over
+ */
+bool solve_position(Rules *r, Position *p, Piece turn, long maxNodes, const Deadline *deadline, SolverResult *result) {
+  if (get_position_winner(r, p) != PIECE_EMPTY) return false;
+
+  Solver s = { r, 0, maxNodes, deadline, false };
+  int bestBit = -1;
+
+  int score = negamax(&s, p, turn, 0, -SOLVER_WIN - 1, SOLVER_WIN + 1, &bestBit);
+  result->nodes = s.nodes;
+
+  if (s.aborted || bestBit < 0) return false;
+
+  result->move = geom_pos(&r->geom, bestBit);
+
+  if (score > 0) {
+    result->value = 1;
+    result->plies = SOLVER_WIN - score;
+  } else if (score < 0) {
+    result->value = -1;
+    result->plies = SOLVER_WIN + score;
+  } else {
+    result->value = 0;
+    result->plies = 0;
+  }
+
+  return true;
+}
@@ -0,0 +1,249 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "rules.h"
+
+/*
+  Symmetries of the board, numbered so that the first four work on any
+  rectangle and the last four only on squares:
+
+    0 identity          4 transpose (flip over the backslash)
+    1 flip left/right   5 rotate 90 clockwise
+    2 flip up/down      6 rotate 90 counter-clockwise
+    3 rotate 180        7 flip over the forward slash
+
+  Ultimate's 9x9 board is square and every symmetry maps sub-boards onto
+  sub-boards, and squares within a sub-board onto the same squares of the
+  new sub-board, so the target rule is preserved as well.
+*/
+
+static void transform_square(int sym, int rows, int cols, int row, int col, int *newRow, int *newCol) {
+  switch (sym) {
+    case 0:
+      *newRow = row;
+      *newCol = col;
+      break;
+    case 1:
+      *newRow = row;
+      *newCol = cols - 1 - col;
+      break;
+    case 2:
+      *newRow = rows - 1 - row;
+      *newCol = col;
+      break;
+    case 3:
+      *newRow = rows - 1 - row;
+      *newCol = cols - 1 - col;
+      break;
+    case 4:
+      *newRow = col;
+      *newCol = row;
+      break;
+    case 5:
+      *newRow = col;
+      *newCol = rows - 1 - row;
+      break;
+    case 6:
+      *newRow = cols - 1 - col;
+      *newCol = row;
+      break;
+    case 7:
+      *newRow = cols - 1 - col;
+      *newCol = rows - 1 - row;
+      break;
+  }
+}
+
+/**
+ * @brief builds the square permutation for every symmetry of the board
+ *
+ * @param r
+ */
+void init_symmetries(Rules *r) {
+  Geometry *geom = &r->geom;
+  r->numSymmetries = geom->rows == geom->cols ? 8 : 4;
+
+  memset(r->symBits, 0, sizeof(r->symBits));
+
+  for (int sym = 0; sym < r->numSymmetries; sym++) {
+    for (int pos = 0; pos < geom->numSquares; pos++) {
+      int row, col;
+      transform_square(sym, geom->rows, geom->cols, pos / geom->cols, pos % geom->cols, &row, &col);
+      r->symBits[sym][geom_bit(geom, pos)] = geom_bit(geom, (row * geom->cols) + col);
+    }
+
+    for (int sub = 0; sub < ULTIMATE_SIZE; sub++) {
+      int row, col;
+      transform_square(sym, ULTIMATE_DIM, ULTIMATE_DIM, sub / ULTIMATE_DIM, sub % ULTIMATE_DIM, &row, &col);
+      r->symSubs[sym][sub] = (row * ULTIMATE_DIM) + col;
+    }
+  }
+}
+
+int inverse_symmetry(int sym) {
+  // the quarter turns undo each other, everything else undoes itself
+  if (sym == 5) return 6;
+  if (sym == 6) return 5;
+
+  return sym;
+}
+
+int transform_bit(Rules *r, int sym, int bit) {
+  return r->symBits[sym][bit];
+}
+
+static void transform_bitboard(Rules *r, int sym, Bitboard *src, Bitboard *tgt) {
+  Bitboard rest = *src;
+  bb_clear(tgt);
+
+  while (!bb_is_empty(&rest)) {
+    int bit = bb_first_bit(&rest);
+    bb_unset(&rest, bit);
+    bb_set(tgt, r->symBits[sym][bit]);
+  }
+}
+
+static uint16_t transform_subs(Rules *r, int sym, uint16_t subs) {
+  uint16_t out = 0;
+
+  for (int sub = 0; sub < ULTIMATE_SIZE; sub++) {
+    if (subs & (1 << sub)) out |= 1 << r->symSubs[sym][sub];
+  }
+
+  return out;
+}
+
+void transform_position(Rules *r, int sym, Position *src, Position *tgt) {
+  Position out;
+
+  transform_bitboard(r, sym, &src->pieces[PIECE_X], &out.pieces[PIECE_X]);
+  transform_bitboard(r, sym, &src->pieces[PIECE_O], &out.pieces[PIECE_O]);
+  out.subWon[PIECE_X] = transform_subs(r, sym, src->subWon[PIECE_X]);
+  out.subWon[PIECE_O] = transform_subs(r, sym, src->subWon[PIECE_O]);
+  out.subClosed = transform_subs(r, sym, src->subClosed);
+  out.target = src->target < 0 ? -1 : r->symSubs[sym][src->target];
+
+  *tgt = out;
+}
+
+static bool maps_to_itself(Rules *r, int sym, Bitboard *b) {
+  Bitboard rest = *b;
+
+  while (!bb_is_empty(&rest)) {
+    int bit = bb_first_bit(&rest);
+    bb_unset(&rest, bit);
+    if (!bb_test(b, r->symBits[sym][bit])) return false;
+  }
+
+  return true;
+}
+
+/**
+ * @brief finds the symmetries that leave the position unchanged. The
+ * identity is always one of them
+ *
+ * @param r
+ * @param p
+ * @param syms filled with up to MAX_SYMMETRIES symmetries
+ * @return int how many were found
+ */
+int get_stabilizer(Rules *r, Position *p, int *syms) {
+  int count = 0;
+  syms[count++] = 0;
+
+  for (int sym = 1; sym < r->numSymmetries; sym++) {
+    if (p->target >= 0 && r->symSubs[sym][p->target] != p->target) continue;
+    if (!maps_to_itself(r, sym, &p->pieces[PIECE_X])) continue;
+    if (!maps_to_itself(r, sym, &p->pieces[PIECE_O])) continue;
+
+    syms[count++] = sym;
+  }
+
+  return count;
+}
+
+/**
+ * @brief drops every move that is a mirror image of another move, keeping
+ * the lowest bit of each class. Moves that map onto each other under a
+ * symmetry of the position lead to equivalent positions, so only one of
+ * them needs to be searched
+ *
+ * @param r
+ * @param p
+ * @param moves legal moves, reduced in place
+ */
+void get_unique_moves(Rules *r, Position *p, Bitboard *moves) {
+  int syms[MAX_SYMMETRIES];
+  int numSyms = get_stabilizer(r, p, syms);
+  if (numSyms == 1) return;
+
+  Bitboard rest = *moves;
+
+  while (!bb_is_empty(&rest)) {
+    int bit = bb_first_bit(&rest);
+    bb_unset(&rest, bit);
+
+    for (int i = 1; i < numSyms; i++) {
+      if (r->symBits[syms[i]][bit] < bit) {
+        bb_unset(moves, bit);
+        break;
+      }
+    }
+  }
+}
+
+static int compare_positions(Position *a, Position *b) {
+  for (int piece = PIECE_X; piece <= PIECE_O; piece++) {
+    for (int i = BB_WORDS - 1; i >= 0; i--) {
+      if (a->pieces[piece].w[i] != b->pieces[piece].w[i]) {
+        return a->pieces[piece].w[i] < b->pieces[piece].w[i] ? -1 : 1;
+      }
+    }
+  }
+
+  return a->target - b->target;
+}
+
+static uint64_t mix(uint64_t h, uint64_t v) {
+  h ^= v + 0x9E3779B97F4A7C15ULL + (h << 6) + (h >> 2);
+  h *= 0xBF58476D1CE4E5B9ULL;
+  return h ^ (h >> 31);
+}
+
+/**
+ * @brief hashes the position's canonical form: the smallest of its
+ * images under every symmetry of the board, so all mirror images of a
+ * position share one key
+ *
+ * @param r
+ * @param p
+ * @param sym optional, set to the symmetry that takes p to its canonical form
+ * @return uint64_t
+ */
+uint64_t get_canonical_key(Rules *r, Position *p, int *sym) {
+  Position best = *p;
+  int bestSym = 0;
+
+  for (int i = 1; i < r->numSymmetries; i++) {
+    Position image;
+    transform_position(r, i, p, &image);
+
+    if (compare_positions(&image, &best) < 0) {
+      best = image;
+      bestSym = i;
+    }
+  }
+
+  if (sym != NULL) *sym = bestSym;
+
+  uint64_t h = (uint64_t)r->variant;
+  h = mix(h, ((uint64_t)r->geom.rows << 16) | ((uint64_t)r->geom.cols << 8) | (uint64_t)r->geom.k);
+
+  for (int piece = PIECE_X; piece <= PIECE_O; piece++) {
+    for (int i = 0; i < BB_WORDS; i++) {
+      h = mix(h, best.pieces[piece].w[i]);
+    }
+  }
+
+  return mix(h, (uint64_t)(best.target + 1));
+}
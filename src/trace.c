@@ -0,0 +1,277 @@
+// for gettid
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "trace.h"
+#include "alloc.h"
+
+// longest line an event can format to
+#define TRACE_LINE 192
+// formatted events are written out this many bytes at a time
+#define TRACE_CHUNK 65536
+
+typedef struct TraceEvent {
+  const char *name;
+  const char *argName;    // NULL for no args
+  long arg;
+  uint64_t ts;            // microseconds
+  uint64_t dur;
+  char phase;             // 'X' complete or 'i' instant
+} TraceEvent;
+
+/*
+  One per thread that has traced anything, in two halves. The thread
+  fills one half while the writer thread writes out the other, so a
+  search never waits on the file. If the writer hasn't finished with the
+  other half when the thread's half fills up, the thread's events are
+  dropped and counted rather than waited on.
+*/
+typedef struct TraceBuffer {
+  struct TraceBuffer *next;
+  int tid;                // the thread's OS id, as perf and top show it
+  int active;             // half the thread is filling
+  int count;              // events in the active half
+  atomic_int pending;     // events in the other half still to be written
+  long dropped;
+  TraceEvent events[2][TRACE_BUFFER_EVENTS];
+} TraceBuffer;
+
+static int traceFd = -1;
+static int tracePid = 0;
+static _Atomic(TraceBuffer*) buffers = NULL;
+static atomic_int traceGeneration = 0;   // bumped by close_trace
+static pthread_t writer;
+static sem_t writerWake;                  // posted when a half is handed over
+static atomic_bool writerStop = false;
+static _Thread_local TraceBuffer *threadBuffer = NULL;
+static _Thread_local int threadGeneration = 0;
+
+static void *write_trace(void *arg);
+
+/**
+ * @brief starts writing a trace to path, replacing anything there
+ * 
+ * @param path 
+ * @return true if the file could be opened
+ */
+bool open_trace(const char *path) {
+  int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+  if (fd < 0) return false;
+
+  if (write(fd, "[\n", 2) != 2) {
+    close(fd);
+    return false;
+  }
+
+  tracePid = (int)getpid();
+  traceFd = fd;
+
+  sem_init(&writerWake, 0, 0);
+  atomic_store(&writerStop, false);
+  pthread_create(&writer, NULL, write_trace, NULL);
+
+  return true;
+}
+
+bool is_tracing() {
+  return traceFd >= 0;
+}
+
+uint64_t trace_now() {
+  if (traceFd < 0) return 0;
+
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  return ((uint64_t)now.tv_sec * 1000000) + ((uint64_t)now.tv_nsec / 1000);
+}
+
+static int format_event(char *out, TraceEvent *e, int tid) {
+  int n = snprintf(out, TRACE_LINE, "{\"name\":\"%s\",\"cat\":\"search\",\"ph\":\"%c\",\"ts\":%lu,\"pid\":%d,\"tid\":%d",
+    e->name, e->phase, (unsigned long)e->ts, tracePid, tid);
+
+  if (e->phase == 'X') {
+    n += snprintf(out + n, TRACE_LINE - n, ",\"dur\":%lu", (unsigned long)e->dur);
+  } else {
+    n += snprintf(out + n, TRACE_LINE - n, ",\"s\":\"t\"");
+  }
+
+  if (e->argName != NULL) {
+    n += snprintf(out + n, TRACE_LINE - n, ",\"args\":{\"%s\":%ld}", e->argName, e->arg);
+  }
+
+  n += snprintf(out + n, TRACE_LINE - n, "},\n");
+
+  return n;
+}
+
+static void write_chunk(const char *out, size_t len) {
+  if (write(traceFd, out, len) != (ssize_t)len) {
+    // a short trace is still useful, keep going
+  }
+}
+
+/**
+ * @brief writes out a buffer's events a chunk of whole lines at a time.
+ * O_APPEND keeps each write in one piece when other threads are writing
+ * 
+ * @param b 
+ */
+static void write_events(TraceEvent *events, int count, int tid) {
+  char out[TRACE_CHUNK];
+  size_t len = 0;
+
+  for (int i = 0; i < count; i++) {
+    if (len + TRACE_LINE > sizeof(out)) {
+      write_chunk(out, len);
+      len = 0;
+    }
+    len += format_event(out + len, &events[i], tid);
+  }
+
+  if (len > 0) write_chunk(out, len);
+}
+
+/**
+ * @brief writes out every half that has been handed over, then hands
+ * the halves back
+ */
+static void write_pending() {
+  for (TraceBuffer *b = atomic_load(&buffers); b != NULL; b = b->next) {
+    int count = atomic_load(&b->pending);
+    if (count == 0) continue;
+
+    write_events(b->events[1 - b->active], count, b->tid);
+    atomic_store(&b->pending, 0);
+  }
+}
+
+static void *write_trace(void *arg) {
+  (void)arg;
+
+  while (!atomic_load(&writerStop)) {
+    sem_wait(&writerWake);
+    write_pending();
+  }
+
+  return NULL;
+}
+
+static TraceEvent *next_event() {
+  TraceBuffer *b = threadBuffer;
+
+  // a buffer from before the last close_trace is gone
+  if (b == NULL || threadGeneration != atomic_load(&traceGeneration)) {
+    b = ttt_malloc(sizeof(TraceBuffer));
+    b->tid = (int)gettid();
+    b->active = 0;
+    b->count = 0;
+    atomic_init(&b->pending, 0);
+    b->dropped = 0;
+
+    // push onto the list of buffers without a lock
+    b->next = atomic_load(&buffers);
+    while (!atomic_compare_exchange_weak(&buffers, &b->next, b));
+
+    threadBuffer = b;
+    threadGeneration = atomic_load(&traceGeneration);
+  }
+
+  if (b->count == TRACE_BUFFER_EVENTS) {
+    // the writer is still busy with the other half
+    if (atomic_load(&b->pending) != 0) {
+      b->dropped++;
+      return NULL;
+    }
+
+    b->active = 1 - b->active;
+    atomic_store(&b->pending, b->count);
+    b->count = 0;
+    sem_post(&writerWake);
+  }
+
+  return &b->events[b->active][b->count++];
+}
+
+/**
+ * @brief records something that ran from startUs until now
+ * 
+ * @param name 
+ * @param startUs from trace_now
+ * @param argName NULL for no args
+ * @param arg 
+ */
+void trace_complete(const char *name, uint64_t startUs, const char *argName, long arg) {
+  if (traceFd < 0) return;
+
+  uint64_t now = trace_now();
+  TraceEvent *e = next_event();
+  if (e == NULL) return;
+
+  e->name = name;
+  e->argName = argName;
+  e->arg = arg;
+  e->ts = startUs;
+  e->dur = now - startUs;
+  e->phase = 'X';
+}
+
+void trace_instant(const char *name, const char *argName, long arg) {
+  if (traceFd < 0) return;
+
+  uint64_t now = trace_now();
+  TraceEvent *e = next_event();
+  if (e == NULL) return;
+
+  e->name = name;
+  e->argName = argName;
+  e->arg = arg;
+  e->ts = now;
+  e->dur = 0;
+  e->phase = 'i';
+}
+
+/**
+ * @brief stops the writer thread, flushes every thread's buffer and
+ * finishes the file. The buffers of threads that have exited are
+ * flushed too
+ */
+void close_trace() {
+  if (traceFd < 0) return;
+
+  atomic_fetch_add(&traceGeneration, 1);
+
+  atomic_store(&writerStop, true);
+  sem_post(&writerWake);
+  pthread_join(writer, NULL);
+  sem_destroy(&writerWake);
+
+  // the older half of each buffer first, so events stay in order
+  write_pending();
+
+  long dropped = 0;
+  TraceBuffer *b = atomic_exchange(&buffers, NULL);
+  while (b != NULL) {
+    TraceBuffer *next = b->next;
+    write_events(b->events[b->active], b->count, b->tid);
+    dropped += b->dropped;
+    ttt_free(b);
+    b = next;
+  }
+
+  // the metadata event closes the array without a trailing comma
+  char end[192];
+  int n = snprintf(end, sizeof(end), "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"ttt\",\"droppedEvents\":%ld}}\n]\n", tracePid, dropped);
+  write_chunk(end, n);
+
+  close(traceFd);
+  traceFd = -1;
+}
@@ -0,0 +1,140 @@
+#include <stdlib.h>
+#include <stdbool.h>
+
+#include "game.h"
+
+void init_ultimate(Ultimate *u) {
+  for (int i = 0; i < ULTIMATE_SIZE; i++) {
+    init_board(&u->subBoards[i], ULTIMATE_DIM, ULTIMATE_DIM, ULTIMATE_DIM);
+  }
+
+  init_board(&u->meta, ULTIMATE_DIM, ULTIMATE_DIM, ULTIMATE_DIM);
+  u->target = -1;
+}
+
+void reset_ultimate(Ultimate *u) {
+  for (int i = 0; i < ULTIMATE_SIZE; i++) {
+    reset_board(&u->subBoards[i]);
+  }
+
+  reset_board(&u->meta);
+  u->target = -1;
+}
+
+/**
+ * @brief returns which sub-board a square of the 9x9 board belongs to
+ *
+ * @param pos
+ * @return int
+ */
+int get_sub_board(int pos) {
+  int row = pos / ULTIMATE_SIZE;
+  int col = pos % ULTIMATE_SIZE;
+
+  return ((row / ULTIMATE_DIM) * ULTIMATE_DIM) + (col / ULTIMATE_DIM);
+}
+
+/**
+ * @brief returns the position of a square of the 9x9 board within its
+ * sub-board
+ *
+ * @param pos
+ * @return int
+ */
+int get_sub_square(int pos) {
+  int row = pos / ULTIMATE_SIZE;
+  int col = pos % ULTIMATE_SIZE;
+
+  return ((row % ULTIMATE_DIM) * ULTIMATE_DIM) + (col % ULTIMATE_DIM);
+}
+
+int get_ultimate_pos(int sub, int square) {
+  int row = ((sub / ULTIMATE_DIM) * ULTIMATE_DIM) + (square / ULTIMATE_DIM);
+  int col = ((sub % ULTIMATE_DIM) * ULTIMATE_DIM) + (square % ULTIMATE_DIM);
+
+  return (row * ULTIMATE_SIZE) + col;
+}
+
+/**
+ * @brief a sub-board is closed once it has been won or filled up
+ *
+ * @param u
+ * @param sub
+ * @return true
+ * @return false
+ */
+bool is_sub_board_closed(Ultimate *u, int sub) {
+  if (u->meta.squares[sub].piece != PIECE_EMPTY) return true;
+
+  return num_empty_squares(&u->subBoards[sub]) == 0;
+}
+
+bool is_ultimate_move_legal(Ultimate *u, Board *b, int pos) {
+  if (pos < 0 || pos >= b->numSquares) return false;
+  if (b->squares[pos].piece != PIECE_EMPTY) return false;
+
+  int sub = get_sub_board(pos);
+  if (is_sub_board_closed(u, sub)) return false;
+
+  return u->target < 0 || u->target == sub;
+}
+
+bool has_ultimate_moves(Ultimate *u, Board *b) {
+  for (int i = 0; i < b->numSquares; i++) {
+    if (is_ultimate_move_legal(u, b, i)) return true;
+  }
+
+  return false;
+}
+
+/**
+ * @brief colors the winning line of a sub-board on the 9x9 board
+ *
+ * @param u
+ * @param b
+ * @param sub
+ * @param wl
+ */
+static void color_sub_board_line(Ultimate *u, Board *b, int sub, Line wl) {
+  Board *s = &u->subBoards[sub];
+  SquareColor c = get_winning_piece(s, wl) == PIECE_X ? SQ_GREEN : SQ_RED;
+  int step = get_line_step(s, wl);
+
+  for (int i = 0; i < s->k; i++) {
+    int square = LINE_START(wl) + (i * step);
+    b->squares[get_ultimate_pos(sub, square)].color = c;
+  }
+}
+
+/**
+ * @brief places a piece on the 9x9 board, then settles the sub-board it
+ * landed in and points the next move at the matching sub-board
+ *
+ * @param u
+ * @param b
+ * @param pos
+ * @param p
+ * @return BoardPlacementResult
+ */
+BoardPlacementResult place_ultimate_piece(Ultimate *u, Board *b, int pos, Piece p) {
+  if (!is_ultimate_move_legal(u, b, pos)) return BPR_INVALID;
+
+  BoardPlacementResult r = place_piece(b, pos, p);
+  if (r != BPR_OK) return r;
+
+  int sub = get_sub_board(pos);
+  int square = get_sub_square(pos);
+
+  // sub-boards don't alternate turns on their own, so skip place_piece
+  u->subBoards[sub].squares[square].piece = p;
+
+  Line wl = get_winning_line(&u->subBoards[sub]);
+  if (wl != NO_WINNER) {
+    u->meta.squares[sub].piece = p;
+    color_sub_board_line(u, b, sub, wl);
+  }
+
+  u->target = is_sub_board_closed(u, square) ? -1 : square;
+
+  return BPR_OK;
+}